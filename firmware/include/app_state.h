@@ -1,11 +1,7 @@
 #pragma once
 #include <stdint.h>
 
-struct SongMeta {
-  char uri[192];
-  char title[96];
-  uint32_t durationMs;
-};
+#include "sync_engine.h"
 
-extern SongMeta g_song;
-extern uint32_t g_songTimeMs;
\ No newline at end of file
+// Whole-song sync state machine (song meta, song time, recording state).
+extern SyncEngine g_sync;
\ No newline at end of file
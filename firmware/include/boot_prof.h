@@ -0,0 +1,24 @@
+#pragma once
+#include <Arduino.h>
+
+/*
+  Boot-phase profiler. Phases may overlap (the Wi-Fi join runs on its own
+  task while setup() continues); times are microseconds since app start.
+*/
+static const int BOOT_MAX_PHASES = 12;
+
+struct BootPhase {
+  const char* name;
+  uint32_t startUs;
+  uint32_t endUs;  // 0 while still running
+};
+
+int boot_phase_begin(const char* name);
+void boot_phase_end(int id);
+void boot_mark_advertising();
+
+int boot_phase_count();
+const BootPhase& boot_phase(int id);
+uint32_t boot_advertise_us();  // time-to-advertise, 0 if not yet
+
+void boot_report(Print& out);
\ No newline at end of file
@@ -0,0 +1,16 @@
+#pragma once
+#include <Arduino.h>
+
+/*
+  Serial console output for code that runs outside loop() (Wi-Fi supervisor
+  task, NimBLE callbacks). The bulk offload owns the UART while it streams
+  frames, and a log line from another task would corrupt them, so
+  console_quiet(true) mutes these calls, and ESP-IDF logs, until
+  console_quiet(false). Once it returns, no console line is mid-print.
+  loop() itself is blocked during the offload and keeps using Serial
+  directly.
+*/
+void console_begin();  // after Serial.begin(), before other tasks start
+void console_quiet(bool quiet);
+void console_printf(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+void console_println(const char* line);
\ No newline at end of file
@@ -1,11 +1,40 @@
 #pragma once
 #include <Arduino.h>
 
+#include "timeline.h"
+
 bool event_log_begin();  // mounts LittleFS
 
-void log_song(const String& uri, const String& title, uint32_t durationMs);
-void log_clip_start(const String& filename, uint32_t songMs);
-void log_clip_end(const String& filename, uint32_t songMs);
+// Every line ends with " dev=<id> seq=<n> t=<ms since boot>" (event_format.h).
+void event_log_set_device(const char* id);
+const char* event_log_device();
+uint32_t event_log_seq();  // seq of the last line written
+
+void log_song(const char* uri, const char* title, uint32_t durationMs);
+void log_clip_start(const char* filename, uint32_t songMs);
+void log_clip_end(const char* filename, uint32_t songMs);
+void log_clip_gap(const char* filename, uint32_t fromMs, uint32_t toMs, uint32_t pauseMs);
+void log_clip_at(const char* filename, uint32_t songMs);
+void log_clip_recovered(const char* filename, uint32_t songMs);
+void log_clip_lost(const char* filename, uint32_t songMs);
 void clear_events();
 
-String read_events();
\ No newline at end of file
+// Receives one block of a ranged read; len is at most FS_READ_BLOCK bytes.
+typedef void (*ChunkSink)(const uint8_t* data, size_t len, void* ctx);
+
+static const size_t FS_READ_BLOCK = 512;
+
+size_t events_size();
+size_t file_size(const char* path);
+
+// Streams [offset, offset+len) of a file to sink in FS_READ_BLOCK pieces.
+// Returns the continuation offset (offset of the first byte NOT delivered).
+size_t read_file_range(const char* path, size_t offset, size_t len,
+                       ChunkSink sink, void* ctx);
+size_t read_events_range(size_t offset, size_t len, ChunkSink sink, void* ctx);
+
+// Boot-time recovery: scans only the last EVENTS_TAIL_BYTES of the log (so
+// cost is flat in log size), terminates a line torn by the reset and resumes
+// the sequence numbering after the last stamped line.
+static const size_t EVENTS_TAIL_BYTES = 8192;
+bool recover_log_tail(LogTail* out);
\ No newline at end of file
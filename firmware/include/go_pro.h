@@ -1,6 +1,40 @@
 #pragma once
 #include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
 
-bool goproBegin(const char* ssid, const char* pass);
-bool goproShutter(bool on);
\ No newline at end of file
+enum GoproLink {
+  GOPRO_LINK_DOWN,        // not associated, waiting for backoff
+  GOPRO_LINK_CONNECTING,  // association/DHCP in progress
+  GOPRO_LINK_UP,          // associated, camera reachable at 10.5.5.9
+};
+
+struct GoproLinkStats {
+  uint32_t connects;        // successful associations
+  uint32_t drops;           // link losses after being up
+  uint32_t fastConnects;    // via cached BSSID/channel/IP
+  uint32_t coldConnects;    // scan + DHCP
+  uint32_t lastFastMs;      // duration of the last fast-path connect
+  uint32_t lastColdMs;      // duration of the last cold connect
+  uint32_t shutterSent;     // shutter requests sent to the camera
+  bool lastShutterOn;       // last sent command (true = START)
+  bool lastShutterOk;       // ...and whether the camera accepted it
+};
+
+// Starts the Wi-Fi link supervisor task; returns immediately. The task
+// drives (re)connects, backoff, keep-alive and the shutter command in flight.
+void goproBegin(const char* ssid, const char* pass);
+
+GoproLink goproLinkState();
+const char* goproLinkName(GoproLink s);
+const GoproLinkStats& goproLinkStats();
+
+// Hands one shutter command to the supervisor task (any task, non-blocking);
+// false while the previous one is still in flight.
+bool goproShutter(bool on);
+bool goproShutterIdle();  // no command in flight
+
+// Asks the supervisor task to read the camera's recording state once the
+// link is up. goproCameraRecording() is -1 until answered, then 0 or 1.
+void goproQueryRecording();
+int goproCameraRecording();
\ No newline at end of file
@@ -0,0 +1,16 @@
+#pragma once
+#include <Arduino.h>
+
+#include "offload_frame.h"
+
+/*
+  USB-serial bulk offload ('o' command). Announces "OFFLOAD <baud> <files>" at
+  the console rate, switches the UART to <baud>, streams the session files as
+  COBS frames with CRC-32 (firmware/lib/offload), then returns to 115200.
+  Host side: tools/ msync-offload.
+*/
+static const uint32_t CONSOLE_BAUD = 115200;
+
+// Blocks the main loop for the transfer. only: one file path, or nullptr for
+// every file on LittleFS (exports are refreshed first).
+void offload_run(uint32_t baud, const char* only);
\ No newline at end of file
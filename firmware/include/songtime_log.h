@@ -0,0 +1,26 @@
+#pragma once
+#include <Arduino.h>
+#include "event_log.h"
+#include "songtime_trace.h"
+
+/*
+  Song-time trace for post-sync correction (/songtime.bin, format in
+  songtime_trace.h). Every digits-only BLE write is kept with its millis()
+  arrival time at ~1-2 bytes per update; only blocks that overlap a recording
+  reach flash. export_project() uses it to refine clip boundaries and mark
+  seeks, stalls and BLE gaps.
+*/
+static const size_t SONGTIME_MAX_BYTES = 256 * 1024;  // stop appending samples past this
+
+void songtime_begin();                   // setup(), once the log tail restored the seq
+void songtime_record(uint32_t songMs);   // any task
+void songtime_tick(bool recording);      // main loop: write finished blocks
+void songtime_flush();                   // also write the open block if it is kept
+void songtime_clear();                   // with clear_events()
+uint32_t songtime_dropped();
+
+// Refines a parsed timeline from /songtime.bin. false if there is no trace.
+bool songtime_refine(Timeline* tl, SongTimeRefineStats* stats);
+
+size_t songtime_size();
+size_t read_songtime_range(size_t offset, size_t len, ChunkSink sink, void* ctx);
\ No newline at end of file
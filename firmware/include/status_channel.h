@@ -0,0 +1,19 @@
+#pragma once
+#include <Arduino.h>
+#include <NimBLEDevice.h>
+
+/*
+  Live status characteristic (NOTIFY + READ).
+  Notifications are coalesced and rate-limited deltas:
+    "S<seq> key=value;key=value"  changed fields only
+    "F<seq> key=value;..."         full snapshot (on subscribe, every 30 s)
+  A gap in <seq> means a delta was missed; read the characteristic (always a
+  full snapshot, from the main loop's last sample, at most 100 ms old) to
+  resync.
+  Keys: play, rec, clip, t (interpolated song ms, sent on drift > 500 ms),
+        link (down|connecting|up), shut (<seq>:start|stop:ok|fail),
+        fs (usedKB/totalKB), heap (free KB),
+        sup (redundant metadata messages suppressed)
+*/
+void status_begin(NimBLEService* svc);
+void status_tick();
\ No newline at end of file
@@ -0,0 +1,19 @@
+#pragma once
+#include <Arduino.h>
+#include "event_log.h"
+
+/*
+  Inbound message capture for offline replay (tools/ msync-syncsim).
+  /trace.log lines: "<millis> <B|S> <payload>"
+    B = BLE write to the NUS RX characteristic, S = serial command line
+*/
+void trace_start();    // truncates /trace.log and starts recording
+void trace_stop();     // flushes and stops
+bool trace_active();
+uint32_t trace_dropped();
+
+void trace_record(char source, const uint8_t* data, size_t len);  // any task
+void trace_flush();    // main loop: move buffered records to flash
+
+size_t trace_size();
+size_t read_trace_range(size_t offset, size_t len, ChunkSink sink, void* ctx);
\ No newline at end of file
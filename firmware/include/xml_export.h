@@ -1,5 +1,7 @@
 #pragma once
 #include <Arduino.h>
+#include "event_log.h"
 
-bool export_xml_from_events(const String& eventsText);
-String read_project_xml();  // helper for printing later
\ No newline at end of file
+// Writes /project.xml plus .fcpxml, .edl and .otio from one parse of the log.
+bool export_project();
+const char* export_path(const char* format);  // "xml", "fcpxml", "edl", "otio"
\ No newline at end of file
@@ -0,0 +1,53 @@
+#include "cobs.h"
+
+/**
+ * COBS-encode a frame (without the trailing 0x00 delimiter).
+ * @param in Frame bytes
+ * @param len Number of bytes
+ * @param out Output buffer of at least cobs_max_encoded(len) bytes
+ * @return Encoded length
+ */
+size_t cobs_encode(const uint8_t* in, size_t len, uint8_t* out) {
+  size_t code_at = 0;
+  size_t o = 1;
+  uint8_t code = 1;
+
+  for (size_t i = 0; i < len; i++) {
+    if (in[i] == 0) {
+      out[code_at] = code;
+      code_at = o++;
+      code = 1;
+      continue;
+    }
+    out[o++] = in[i];
+    if (++code == 0xFF) {
+      out[code_at] = code;
+      code_at = o++;
+      code = 1;
+    }
+  }
+  out[code_at] = code;
+  return o;
+}
+
+/**
+ * Decode one COBS frame (delimiter already stripped).
+ * @param in Encoded bytes
+ * @param len Number of bytes
+ * @param out Output buffer of at least len bytes (may equal in)
+ * @param outLen Receives the decoded length
+ * @return false if the frame is malformed (a code byte points past the end)
+ */
+bool cobs_decode(const uint8_t* in, size_t len, uint8_t* out, size_t* outLen) {
+  size_t i = 0;
+  size_t o = 0;
+
+  while (i < len) {
+    uint8_t code = in[i++];
+    if (code == 0 || i + code - 1 > len) return false;
+    for (uint8_t k = 1; k < code; k++) out[o++] = in[i++];
+    if (code != 0xFF && i < len) out[o++] = 0;
+  }
+  *outLen = o;
+  return true;
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Consistent Overhead Byte Stuffing: rewrites a frame so it contains no 0x00,
+// leaving 0x00 free to delimit frames on a byte stream.
+static inline size_t cobs_max_encoded(size_t len) {
+  return len + len / 254 + 1;
+}
+
+size_t cobs_encode(const uint8_t* in, size_t len, uint8_t* out);
+bool cobs_decode(const uint8_t* in, size_t len, uint8_t* out, size_t* outLen);
\ No newline at end of file
@@ -0,0 +1,31 @@
+#include "crc32.h"
+
+/**
+ * Nibble-wise CRC-32 table (reflected polynomial 0xEDB88320).
+ * @brief 16 entries instead of 256: 64 bytes of flash and still well above
+ *        UART speed on the ESP32.
+ */
+static const uint32_t CRC_NIBBLE[16] = {
+  0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+  0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+  0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+  0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
+
+/**
+ * Continue a CRC-32 over more bytes.
+ * @param crc CRC of the data so far (0 for none)
+ * @param data Next bytes
+ * @param len Number of bytes
+ * @return CRC of all bytes fed so far
+ */
+uint32_t crc32_update(uint32_t crc, const void* data, size_t len) {
+  const uint8_t* p = (const uint8_t*)data;
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= p[i];
+    crc = (crc >> 4) ^ CRC_NIBBLE[crc & 0x0F];
+    crc = (crc >> 4) ^ CRC_NIBBLE[crc & 0x0F];
+  }
+  return ~crc;
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32 (IEEE 802.3, same as zlib). Start from 0 and chain calls to
+// checksum a stream block by block.
+uint32_t crc32_update(uint32_t crc, const void* data, size_t len);
\ No newline at end of file
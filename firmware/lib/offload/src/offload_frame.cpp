@@ -0,0 +1,230 @@
+#include "offload_frame.h"
+#include <string.h>
+
+#include "crc32.h"
+
+/*
+  LITTLE-ENDIAN HELPERS
+*/
+static uint8_t* put_u16(uint8_t* p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  return p + 2;
+}
+
+static uint8_t* put_u32(uint8_t* p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+  return p + 4;
+}
+
+static uint16_t get_u16(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/*
+  ENCODER
+*/
+OffloadEncoder::OffloadEncoder(OffloadWrite write, void* ctx)
+    : write_(write), ctx_(ctx), seq_(0) {}
+
+/**
+ * Checksum, COBS-encode and write one frame plus its delimiter.
+ * @param type Frame type (OffloadType)
+ * @param payload Payload bytes (at most OFFLOAD_MAX_PAYLOAD)
+ * @param len Payload length
+ */
+void OffloadEncoder::frame(uint8_t type, const uint8_t* payload, size_t len) {
+  if (len > OFFLOAD_MAX_PAYLOAD) return;
+  raw_[0] = type;
+  put_u16(raw_ + 1, seq_++);
+  memcpy(raw_ + 3, payload, len);
+  put_u32(raw_ + 3 + len, crc32_update(0, raw_, 3 + len));
+
+  size_t n = cobs_encode(raw_, 3 + len + 4, enc_);
+  enc_[n++] = 0;
+  write_(enc_, n, ctx_);
+}
+
+void OffloadEncoder::sync() {
+  static const uint8_t DELIM = 0;
+  write_(&DELIM, 1, ctx_);
+}
+
+/**
+ * Send the list of files that follow.
+ * @param files Names and sizes
+ * @param count Number of files (at most OFFLOAD_MAX_FILES)
+ */
+void OffloadEncoder::manifest(const OffloadEntry* files, int count) {
+  uint8_t p[OFFLOAD_MAX_PAYLOAD];
+  uint8_t* w = put_u16(p, (uint16_t)count);
+  for (int i = 0; i < count && i < OFFLOAD_MAX_FILES; i++) {
+    size_t n = strnlen(files[i].name, OFFLOAD_NAME_MAX - 1);
+    w = put_u32(w, files[i].size);
+    *w++ = (uint8_t)n;
+    memcpy(w, files[i].name, n);
+    w += n;
+  }
+  frame(OFFLOAD_MANIFEST, p, w - p);
+}
+
+void OffloadEncoder::file(uint16_t index, uint32_t size, const char* name) {
+  uint8_t p[6 + OFFLOAD_NAME_MAX];
+  size_t n = strnlen(name, OFFLOAD_NAME_MAX - 1);
+  uint8_t* w = put_u32(put_u16(p, index), size);
+  memcpy(w, name, n);
+  frame(OFFLOAD_FILE, p, 6 + n);
+}
+
+/**
+ * Send one block of file content.
+ * @param index File index in the manifest
+ * @param offset Offset of the block in the file
+ * @param bytes Block bytes (at most OFFLOAD_BLOCK)
+ * @param len Block length
+ */
+void OffloadEncoder::data(uint16_t index, uint32_t offset, const uint8_t* bytes, size_t len) {
+  if (len > OFFLOAD_BLOCK) return;
+  uint8_t p[OFFLOAD_MAX_PAYLOAD];
+  uint8_t* w = put_u32(put_u16(p, index), offset);
+  memcpy(w, bytes, len);
+  frame(OFFLOAD_DATA, p, 6 + len);
+}
+
+void OffloadEncoder::file_end(uint16_t index, uint32_t crc) {
+  uint8_t p[6];
+  put_u32(put_u16(p, index), crc);
+  frame(OFFLOAD_FILE_END, p, sizeof(p));
+}
+
+void OffloadEncoder::done(uint16_t files, uint32_t bytes) {
+  uint8_t p[6];
+  put_u32(put_u16(p, files), bytes);
+  frame(OFFLOAD_DONE, p, sizeof(p));
+}
+
+/*
+  DECODER
+*/
+OffloadDecoder::OffloadDecoder(OffloadHandler handler, void* ctx)
+    : frames(0), crcErrors(0), oversize(0), seqGaps(0), handler_(handler), ctx_(ctx),
+      fill_(0), overflow_(false), haveSeq_(false), nextSeq_(0) {}
+
+/**
+ * Feed received bytes; complete, valid frames go to the handler.
+ * @param data Received bytes (any split)
+ * @param len Number of bytes
+ */
+void OffloadDecoder::feed(const uint8_t* data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    uint8_t b = data[i];
+    if (b == 0) {
+      end_frame();
+      continue;
+    }
+    if (fill_ < sizeof(buf_)) buf_[fill_++] = b;
+    else overflow_ = true;
+  }
+}
+
+/**
+ * Check and deliver the frame collected before a delimiter.
+ */
+void OffloadDecoder::end_frame() {
+  size_t n = fill_;
+  bool over = overflow_;
+  fill_ = 0;
+  overflow_ = false;
+  if (n == 0) return;  // sync byte or back-to-back delimiters
+  if (over) {
+    oversize++;
+    return;
+  }
+
+  size_t len = 0;
+  if (!cobs_decode(buf_, n, buf_, &len) || len < 3 + 4 ||
+      crc32_update(0, buf_, len - 4) != get_u32(buf_ + len - 4)) {
+    crcErrors++;
+    return;
+  }
+
+  OffloadFrame f;
+  f.type = buf_[0];
+  f.seq = get_u16(buf_ + 1);
+  f.payload = buf_ + 3;
+  f.len = len - 3 - 4;
+
+  if (haveSeq_ && f.seq != nextSeq_) seqGaps++;
+  haveSeq_ = true;
+  nextSeq_ = f.seq + 1;
+  frames++;
+  handler_(f, ctx_);
+}
+
+/*
+  PAYLOAD PARSERS
+*/
+bool offload_parse_manifest(const OffloadFrame& f, OffloadEntry* files, int cap, int* count) {
+  if (f.type != OFFLOAD_MANIFEST || f.len < 2) return false;
+  const uint8_t* p = f.payload;
+  const uint8_t* end = p + f.len;
+  int n = get_u16(p);
+  p += 2;
+  if (n > cap) return false;
+
+  for (int i = 0; i < n; i++) {
+    if (end - p < 5) return false;
+    files[i].size = get_u32(p);
+    size_t len = p[4];
+    p += 5;
+    if ((size_t)(end - p) < len || len >= OFFLOAD_NAME_MAX) return false;
+    memcpy(files[i].name, p, len);
+    files[i].name[len] = '\0';
+    p += len;
+  }
+  *count = n;
+  return true;
+}
+
+bool offload_parse_file(const OffloadFrame& f, uint16_t* index, uint32_t* size,
+                        char* name, size_t nameCap) {
+  if (f.type != OFFLOAD_FILE || f.len < 6 || nameCap == 0) return false;
+  *index = get_u16(f.payload);
+  *size = get_u32(f.payload + 2);
+  size_t n = f.len - 6;
+  if (n >= nameCap) n = nameCap - 1;
+  memcpy(name, f.payload + 6, n);
+  name[n] = '\0';
+  return true;
+}
+
+bool offload_parse_data(const OffloadFrame& f, uint16_t* index, uint32_t* offset,
+                        const uint8_t** bytes, size_t* len) {
+  if (f.type != OFFLOAD_DATA || f.len < 6) return false;
+  *index = get_u16(f.payload);
+  *offset = get_u32(f.payload + 2);
+  *bytes = f.payload + 6;
+  *len = f.len - 6;
+  return true;
+}
+
+bool offload_parse_file_end(const OffloadFrame& f, uint16_t* index, uint32_t* crc) {
+  if (f.type != OFFLOAD_FILE_END || f.len < 6) return false;
+  *index = get_u16(f.payload);
+  *crc = get_u32(f.payload + 2);
+  return true;
+}
+
+bool offload_parse_done(const OffloadFrame& f, uint16_t* files, uint32_t* bytes) {
+  if (f.type != OFFLOAD_DONE || f.len < 6) return false;
+  *files = get_u16(f.payload);
+  *bytes = get_u32(f.payload + 2);
+  return true;
+}
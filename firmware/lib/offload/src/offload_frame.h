@@ -0,0 +1,105 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cobs.h"
+
+/*
+  Serial bulk offload framing. Each frame is
+
+    type u8 | seq u16 | payload | crc32 u32      (little-endian)
+
+  with the CRC over type..payload, COBS-encoded and terminated by 0x00, so a
+  receiver drops a corrupted frame and resyncs at the next delimiter.
+  A session is MANIFEST, then FILE / DATA x N / FILE_END per file, then DONE.
+*/
+static const size_t OFFLOAD_BLOCK = 1024;  // file bytes per DATA frame
+static const size_t OFFLOAD_MAX_PAYLOAD = OFFLOAD_BLOCK + 6;
+static const size_t OFFLOAD_MAX_FRAME = 3 + OFFLOAD_MAX_PAYLOAD + 4;
+static const int OFFLOAD_MAX_FILES = 16;
+static const size_t OFFLOAD_NAME_MAX = 32;
+static const uint32_t OFFLOAD_DEFAULT_BAUD = 921600;
+
+enum OffloadType {
+  OFFLOAD_MANIFEST = 'M',  // u16 count, then per file: u32 size, u8 len, name
+  OFFLOAD_FILE = 'F',      // u16 index, u32 size, name
+  OFFLOAD_DATA = 'D',      // u16 index, u32 offset, bytes
+  OFFLOAD_FILE_END = 'E',  // u16 index, u32 crc32 of the whole file
+  OFFLOAD_DONE = 'Z',      // u16 files, u32 total bytes
+};
+
+struct OffloadEntry {
+  char name[OFFLOAD_NAME_MAX];
+  uint32_t size;
+};
+
+struct OffloadFrame {
+  uint8_t type;
+  uint16_t seq;
+  const uint8_t* payload;
+  size_t len;
+};
+
+typedef void (*OffloadWrite)(const uint8_t* data, size_t len, void* ctx);
+typedef void (*OffloadHandler)(const OffloadFrame& frame, void* ctx);
+
+/**
+ * Builds and writes frames (device side, and the host's device emulator).
+ */
+class OffloadEncoder {
+ public:
+  OffloadEncoder(OffloadWrite write, void* ctx);
+
+  void sync();  // lone delimiter: the receiver discards any line noise before it
+  void manifest(const OffloadEntry* files, int count);
+  void file(uint16_t index, uint32_t size, const char* name);
+  void data(uint16_t index, uint32_t offset, const uint8_t* bytes, size_t len);
+  void file_end(uint16_t index, uint32_t crc);
+  void done(uint16_t files, uint32_t bytes);
+
+  uint16_t frames() const { return seq_; }
+
+ private:
+  void frame(uint8_t type, const uint8_t* payload, size_t len);
+
+  OffloadWrite write_;
+  void* ctx_;
+  uint16_t seq_;
+  uint8_t raw_[OFFLOAD_MAX_FRAME];
+  uint8_t enc_[OFFLOAD_MAX_FRAME + OFFLOAD_MAX_FRAME / 254 + 2];
+};
+
+/**
+ * Splits a byte stream into checked frames (host side).
+ */
+class OffloadDecoder {
+ public:
+  OffloadDecoder(OffloadHandler handler, void* ctx);
+
+  void feed(const uint8_t* data, size_t len);
+
+  uint32_t frames;     // frames delivered
+  uint32_t crcErrors;  // dropped: bad CRC or bad COBS
+  uint32_t oversize;   // dropped: longer than OFFLOAD_MAX_FRAME
+  uint32_t seqGaps;    // sequence jumps (frames lost in between)
+
+ private:
+  void end_frame();
+
+  OffloadHandler handler_;
+  void* ctx_;
+  uint8_t buf_[OFFLOAD_MAX_FRAME + OFFLOAD_MAX_FRAME / 254 + 2];
+  size_t fill_;
+  bool overflow_;
+  bool haveSeq_;
+  uint16_t nextSeq_;
+};
+
+// Payload parsers; false if the payload is too short or malformed.
+bool offload_parse_manifest(const OffloadFrame& f, OffloadEntry* files, int cap, int* count);
+bool offload_parse_file(const OffloadFrame& f, uint16_t* index, uint32_t* size,
+                        char* name, size_t nameCap);
+bool offload_parse_data(const OffloadFrame& f, uint16_t* index, uint32_t* offset,
+                        const uint8_t** bytes, size_t* len);
+bool offload_parse_file_end(const OffloadFrame& f, uint16_t* index, uint32_t* crc);
+bool offload_parse_done(const OffloadFrame& f, uint16_t* files, uint32_t* bytes);
\ No newline at end of file
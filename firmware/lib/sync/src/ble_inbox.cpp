@@ -0,0 +1,81 @@
+#include "ble_inbox.h"
+#include <string.h>
+
+#include "sync_engine.h"
+#include "text_util.h"
+
+BleInbox::BleInbox() : head_(0), count_(0), dropped_(0) {
+  memset(slots_, 0, sizeof(slots_));
+}
+
+/**
+ * Classify a raw BLE write.
+ * @param data Received bytes
+ * @param len Number of bytes
+ * @param atMs now_ms() when the write arrived
+ * @param out Message to fill (line is truncated to BLE_INBOX_LINE - 1)
+ * @return false if the write is empty or neither digits nor printable text
+ */
+bool BleInbox::parse(const uint8_t* data, size_t len, uint32_t atMs, BleInboxMsg* out) {
+  if (!data || len == 0) return false;
+  bool time = is_all_digits(data, len);
+  if (!time && !is_printable_ascii(data, len)) return false;
+
+  size_t n = (len < BLE_INBOX_LINE - 1) ? len : BLE_INBOX_LINE - 1;
+  memcpy(out->line, data, n);
+  out->line[n] = '\0';
+  out->at = atMs;
+  out->time = time;
+  out->songMs = time ? parse_u32(out->line) : 0;
+  return true;
+}
+
+/**
+ * Queue a write for the main loop.
+ * @return false if every slot holds an unread message (the write is lost)
+ */
+bool BleInbox::push(const BleInboxMsg& m) {
+  BleInboxMsg* slot = nullptr;
+  if (m.time && count_) {
+    BleInboxMsg* last = &slots_[(head_ + count_ - 1) % BLE_INBOX_SLOTS];
+    if (last->time) slot = last;  // superseded before loop() saw it
+  }
+  if (!slot && count_ < BLE_INBOX_SLOTS) {
+    slot = &slots_[(head_ + count_) % BLE_INBOX_SLOTS];
+    count_++;
+  }
+  if (!slot) {
+    dropped_++;
+    return false;
+  }
+  *slot = m;
+  return true;
+}
+
+/**
+ * Take the oldest queued write.
+ * @return false if the inbox is empty
+ */
+bool BleInbox::pop(BleInboxMsg* out) {
+  if (!count_) return false;
+  *out = slots_[head_];
+  head_ = (head_ + 1) % BLE_INBOX_SLOTS;
+  count_--;
+  return true;
+}
+
+/**
+ * Hand one inbox message to the sync engine.
+ * @param eng Engine (main loop)
+ * @param m Popped message; its line is trimmed in place
+ * @return true if the engine consumed it
+ */
+bool ble_inbox_route(SyncEngine& eng, BleInboxMsg& m) {
+  if (m.time) {
+    eng.set_time(m.songMs, m.at);
+    return true;
+  }
+  trim_inplace(m.line);
+  if (!*m.line) return true;
+  return eng.handle_command(m.line);
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+class SyncEngine;
+
+static const int BLE_INBOX_SLOTS = 8;
+static const size_t BLE_INBOX_LINE = 256;
+
+/**
+ * One inbound BLE write, classified when it arrived.
+ */
+struct BleInboxMsg {
+  uint32_t at;          // now_ms() on arrival
+  bool time;            // digits-only song-time update
+  uint32_t songMs;      // ...its value
+  char line[BLE_INBOX_LINE];
+};
+
+/**
+ * BLE writes waiting for the main loop, in arrival order. A song-time update
+ * replaces one still queued right behind it, so the slots only fill up with
+ * commands.
+ * @brief Not locked: the firmware pushes from the BLE task and pops on
+ *        loop(), each inside its own critical section.
+ */
+class BleInbox {
+ public:
+  BleInbox();
+
+  // Classify a raw write; false if it is neither a song time nor text
+  static bool parse(const uint8_t* data, size_t len, uint32_t atMs, BleInboxMsg* out);
+
+  bool push(const BleInboxMsg& m);  // false (and counted) when full
+  bool pop(BleInboxMsg* out);
+  uint32_t dropped() const { return dropped_; }
+
+ private:
+  BleInboxMsg slots_[BLE_INBOX_SLOTS];
+  int head_;
+  int count_;
+  volatile uint32_t dropped_;
+};
+
+// Run one popped write: a song time goes to set_time(), an 'm'/'p' line to
+// handle_command(). false: the (trimmed) line is for the device's own parser.
+bool ble_inbox_route(SyncEngine& eng, BleInboxMsg& m);
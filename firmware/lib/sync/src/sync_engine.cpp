@@ -0,0 +1,525 @@
+#include "sync_engine.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "text_util.h"
+#include "timeline.h"
+
+SyncEngine::SyncEngine()
+    : songTimeMs_(0), songTimeAtMs_(0), playing_(false), hasMeta_(false), recording_(false),
+      clipStartMs_(0), trackKey_(0), rawHash_(0), recentCount_(0), pendingValid_(false),
+      pendingKey_(0), pendingDeadline_(0), pendingSongMs_(0),
+      pauseHoldMs_(SYNC_PAUSE_HOLD_MS), pauseActive_(false), pausedAtMs_(0),
+      pausedSongMs_(0), checkpointAtMs_(0), checkpointSongMs_(0), recovering_(false),
+      recoverSongMs_(0), cameraCount_(0) {
+  memset(&hooks_, 0, sizeof(hooks_));
+  memset(&song_, 0, sizeof(song_));
+  memset(&pending_, 0, sizeof(pending_));
+  memset(&stats_, 0, sizeof(stats_));
+  filename_[0] = '\0';
+}
+
+/**
+ * 32-bit FNV-1a, continued from h.
+ */
+static uint32_t fnv1a(const void* data, size_t len, uint32_t h = 2166136261u) {
+  const uint8_t* p = (const uint8_t*)data;
+  for (size_t i = 0; i < len; i++) {
+    h ^= p[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+/**
+ * Identity of a track: URI + duration (title text may vary between sends).
+ */
+static uint32_t track_key(const SongMeta& m) {
+  uint32_t h = fnv1a(m.uri, strlen(m.uri));
+  return fnv1a(&m.durationMs, sizeof(m.durationMs), h);
+}
+
+/**
+ * Attach platform hooks. Must be called before any input is delivered.
+ * @param hooks Platform services (copied)
+ */
+void SyncEngine::begin(const SyncHooks& hooks) {
+  hooks_ = hooks;
+}
+
+/**
+ * printf-style diagnostic line through the print hook.
+ */
+void SyncEngine::say(const char* fmt, ...) {
+  if (!hooks_.print) return;
+  char buf[320];
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+  hooks_.print(buf);
+}
+
+/**
+ * Update the current song position.
+ * @param ms Song time in milliseconds (from the phone's 150 ms stream)
+ */
+void SyncEngine::set_time(uint32_t ms) {
+  set_time(ms, hooks_.now_ms ? hooks_.now_ms() : 0);
+}
+
+/**
+ * Update the current song position from an update that arrived earlier.
+ * @param ms Song time in milliseconds
+ * @param atMs now_ms() when the update arrived (interpolation starts there)
+ */
+void SyncEngine::set_time(uint32_t ms, uint32_t atMs) {
+  songTimeMs_ = ms;
+  songTimeAtMs_ = atMs;
+}
+
+/**
+ * Estimate the song position now from the last update.
+ * @return Last song time plus the time since it arrived while playing,
+ *         clamped to the song duration when known
+ */
+uint32_t SyncEngine::interpolated_time() const {
+  uint32_t t = songTimeMs_;
+  if (playing_ && hooks_.now_ms) t += hooks_.now_ms() - songTimeAtMs_;
+  if (song_.durationMs && t > song_.durationMs) t = song_.durationMs;
+  return t;
+}
+
+/**
+ * Update playback state (p1 / p0).
+ * @param playing true when the phone reports playback
+ */
+void SyncEngine::set_playing(bool playing) {
+  playing_ = playing;
+  say(playing ? "[PLAYBACK] PLAY" : "[PLAYBACK] PAUSE/STOP");
+}
+
+/**
+ * Set the pause hysteresis window.
+ * @param ms Pauses shorter than this keep the clip open (0 disables)
+ */
+void SyncEngine::set_pause_hold(uint32_t ms) {
+  pauseHoldMs_ = ms;
+}
+
+/**
+ * Parse and store song metadata from BLE/Serial input.
+ * @param payload Format: "uri=<uri>;title=<title>;dur=<milliseconds>" (modified)
+ * @brief Extracts Spotify URI, song title, and duration, then applies it only
+ *        if it is a different track:
+ *        - byte-identical re-send: dropped before parsing
+ *        - same URI + duration as the current track: dropped (title refreshed)
+ *        - a track replaced within SYNC_STALE_WINDOW_MS: held for the rest of
+ *          that window (re-sends of it count as duplicates, no clip starts
+ *          meanwhile) and dropped if the current track is re-sent meanwhile
+ *          (stale "now playing" replayed after a reconnect); applied when the
+ *          window runs out, as of the moment it arrived (skip back)
+ *        - anything else: logged and the recording is restarted
+ */
+void SyncEngine::set_metadata(char* payload) {
+  trim_inplace(payload);
+  if (*payload == '\0') {
+    say("metadata: empty");
+    return;
+  }
+
+  uint32_t raw = fnv1a(payload, strlen(payload));
+  if (hasMeta_ && !pendingValid_ && raw == rawHash_) {
+    stats_.metaDuplicate++;
+    return;
+  }
+  rawHash_ = raw;
+
+  // Fields missing from the payload keep their current values
+  SongMeta meta = song_;
+
+  char* save = nullptr;
+  for (char* tok = strtok_r(payload, ";", &save);
+       tok;
+       tok = strtok_r(nullptr, ";", &save)) {
+
+    trim_inplace(tok);
+    char* eq = strchr(tok, '=');
+    if (!eq) continue;
+
+    *eq = '\0';
+    char* key = tok;
+    char* val = eq + 1;
+    trim_inplace(key);
+    trim_inplace(val);
+
+    if (strcasecmp(key, "uri") == 0) {
+      safe_copy(meta.uri, sizeof(meta.uri), val);
+    } else if (strcasecmp(key, "title") == 0) {
+      safe_copy(meta.title, sizeof(meta.title), val);
+    } else if (strcasecmp(key, "dur") == 0 || strcasecmp(key, "duration") == 0) {
+      meta.durationMs = parse_u32(val);
+    }
+  }
+
+  uint32_t key = track_key(meta);
+
+  if (pendingValid_ && key == pendingKey_) {
+    // The held track again: still held, its deadline unchanged
+    safe_copy(pending_.title, sizeof(pending_.title), meta.title);
+    stats_.metaDuplicate++;
+    return;
+  }
+
+  if (pendingValid_) {
+    // Anything else arriving inside the window supersedes the held track.
+    pendingValid_ = false;
+    stats_.metaStale++;
+    say("[META] dropped stale track re-send");
+  }
+
+  if (hasMeta_ && key == trackKey_) {
+    safe_copy(song_.title, sizeof(song_.title), meta.title);
+    stats_.metaDuplicate++;
+    return;
+  }
+
+  if (hasMeta_ && recently_replaced(key)) {
+    pending_ = meta;
+    pendingKey_ = key;
+    pendingDeadline_ = hooks_.now_ms() + SYNC_STALE_WINDOW_MS;
+    pendingSongMs_ = songTimeMs_;
+    pendingValid_ = true;
+    stats_.metaDeferred++;
+    say("[META] recent track re-sent, holding %u ms", (unsigned)SYNC_STALE_WINDOW_MS);
+    return;
+  }
+
+  apply_track(meta, key, songTimeMs_);
+}
+
+/**
+ * Make a new track current: log it, end the running clip, new filename.
+ * @param meta Parsed metadata
+ * @param key track_key(meta)
+ * @param endSongMs Song time the running clip ends at
+ */
+void SyncEngine::apply_track(const SongMeta& meta, uint32_t key, uint32_t endSongMs) {
+  // Reset song state on new metadata
+  hasMeta_ = false;
+  if (trackKey_) remember_replaced(trackKey_);
+  song_ = meta;
+  trackKey_ = key;
+  stats_.metaApplied++;
+
+  say("Song meta set: uri=\"%s\" title=\"%s\" durationMs=%u",
+      song_.uri, song_.title, (unsigned)song_.durationMs);
+
+  hooks_.log_song(song_.uri, song_.title, song_.durationMs);
+
+  // A clip restored after a reset belongs to the previous track
+  if (recovering_) {
+    recovering_ = false;
+    stats_.clipsRecovered++;
+    queue_camera(false, true);
+    if (hooks_.log_clip_recovered) hooks_.log_clip_recovered(filename_, recoverSongMs_);
+    say("[RECOVER] clip %s closed at %u ms (track changed)", filename_, (unsigned)recoverSongMs_);
+  }
+
+  // New song => stop old recording state (if any); the stop must reach
+  // the camera even if the new song's start follows right away
+  if (recording_) {
+    recording_ = false;
+    queue_camera(false, true);
+    hooks_.log_clip_end(filename_, pauseActive_ ? pausedSongMs_ : endSongMs);
+  }
+  pauseActive_ = false;
+
+  // Prepare filename for this song session
+  snprintf(filename_, sizeof(filename_), "song_%lu.mp4", (unsigned long)hooks_.now_ms());
+  hasMeta_ = true;
+}
+
+/**
+ * Was this track current until less than SYNC_STALE_WINDOW_MS ago?
+ */
+bool SyncEngine::recently_replaced(uint32_t key) const {
+  uint32_t now = hooks_.now_ms();
+  for (int i = 0; i < recentCount_; i++)
+    if (recent_[i].key == key) return now - recent_[i].replacedAtMs < SYNC_STALE_WINDOW_MS;
+  return false;
+}
+
+/**
+ * Record that a track stopped being current (most recent first, LRU evict).
+ */
+void SyncEngine::remember_replaced(uint32_t key) {
+  int i = 0;
+  while (i < recentCount_ && recent_[i].key != key) i++;
+  if (i == recentCount_ && recentCount_ < SYNC_RECENT_TRACKS) recentCount_++;
+  if (i >= SYNC_RECENT_TRACKS) i = SYNC_RECENT_TRACKS - 1;
+  memmove(&recent_[1], &recent_[0], i * sizeof(recent_[0]));
+  recent_[0].key = key;
+  recent_[0].replacedAtMs = hooks_.now_ms();
+}
+
+/**
+ * Handle the sync-related text commands.
+ * @param line Trimmed command line (modified)
+ * @return true if the line was 'm...' or 'p...', false otherwise
+ */
+bool SyncEngine::handle_command(char* line) {
+  switch (line[0]) {
+    case 'm':  // metadata
+      set_metadata(line + 1);
+      return true;
+
+    case 'p':  // playback state: p1 / p0
+      set_playing(line[1] == '1');
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+/**
+ * Restore a clip that a reset left open in events.log.
+ * @param meta Song the clip belongs to, or nullptr if it wasn't in the log tail
+ * @param file Clip filename
+ * @param lastSongMs Last persisted song time of the clip
+ * @brief The clip stays untouched (no recording, no checkpoints) until
+ *        finish_recovery() or a new track resolves it.
+ */
+void SyncEngine::recover(const SongMeta* meta, const char* file, uint32_t lastSongMs) {
+  if (meta) {
+    song_ = *meta;
+    hasMeta_ = true;
+    trackKey_ = track_key(song_);
+  }
+  safe_copy(filename_, sizeof(filename_), file);
+  songTimeMs_ = lastSongMs;
+  songTimeAtMs_ = hooks_.now_ms();
+  recoverSongMs_ = lastSongMs;
+  recovering_ = true;
+  say("[RECOVER] open clip %s, last song time %u ms", filename_, (unsigned)lastSongMs);
+}
+
+/**
+ * Restore the session from the boot-time scan of the log tail.
+ * @param tail Result of recover_log_tail() / log_tail_scan()
+ * @return true if a clip was restored and should resume or close on the
+ *         camera's recording state; false if there was nothing to restore or
+ *         it was closed already (song unknown or changed since its start)
+ */
+bool SyncEngine::recover(const LogTail& tail) {
+  if (!tail.clipOpen) return false;
+
+  SongMeta meta;
+  safe_copy(meta.uri, sizeof(meta.uri), tail.uri);
+  safe_copy(meta.title, sizeof(meta.title), tail.title);
+  meta.durationMs = tail.durationMs;
+  recover(tail.hasSong ? &meta : nullptr, tail.file, tail.lastMs);
+
+  // Can't resume into a song that isn't known or that already changed
+  if (!tail.hasSong || tail.songChanged) {
+    finish_recovery(false);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Resolve a restored clip once the camera state is known (or given up on).
+ * @param cameraRecording true if the camera reports it is still recording
+ * @brief Resuming needs the song; without it the camera is stopped instead.
+ */
+void SyncEngine::finish_recovery(bool cameraRecording) {
+  if (!recovering_) return;
+  recovering_ = false;
+
+  if (cameraRecording && hasMeta_) {
+    recording_ = true;
+    playing_ = true;  // the camera only records while the song plays
+    checkpointAtMs_ = hooks_.now_ms();
+    stats_.clipsResumed++;
+    say("[RECOVER] camera still recording, clip %s resumed", filename_);
+    return;
+  }
+
+  if (cameraRecording) queue_camera(false, false);
+  stats_.clipsRecovered++;
+  if (hooks_.log_clip_recovered) hooks_.log_clip_recovered(filename_, recoverSongMs_);
+  say("[RECOVER] clip %s closed at %u ms", filename_, (unsigned)recoverSongMs_);
+}
+
+/**
+ * Queue a camera command, collapsing pairs that cancel out.
+ * @param on true = start, false = stop
+ * @param split true if this stop separates two clips and must reach the camera
+ * @brief A start followed by a stop before either was sent is dropped (the
+ *        camera never needed to move); a stop followed by a start is dropped
+ *        unless the stop was a split. When full, the oldest START makes room:
+ *        a STOP is never dropped.
+ */
+void SyncEngine::queue_camera(bool on, bool split) {
+  int n = cameraCount_;
+  if (n > 0) {
+    const CameraCmd& last = camera_[n - 1];
+    if (last.on != on && (last.on || !last.split)) {
+      cameraCount_ = n - 1;
+      stats_.shutterPairsCancelled++;
+      say("[SONG] camera %s/%s collapsed", last.on ? "START" : "STOP", on ? "START" : "STOP");
+      return;
+    }
+  }
+  if (n == SYNC_CAMERA_QUEUE) {
+    int drop = 0;  // all STOPs: dropping one still leaves a STOP queued
+    while (drop < n && !camera_[drop].on) drop++;
+    if (drop == n) drop = 0;
+    say("[SONG] camera queue full, oldest %s dropped", camera_[drop].on ? "START" : "STOP");
+    memmove(&camera_[drop], &camera_[drop + 1], (n - drop - 1) * sizeof(camera_[0]));
+    n--;
+  }
+  camera_[n].on = on;
+  camera_[n].split = split;
+  camera_[n].at = hooks_.now_ms();
+  cameraCount_ = n + 1;
+}
+
+/**
+ * Close the current clip and queue a camera stop.
+ * @param why Reason shown in the diagnostic line
+ * @param songMs Song time the clip ends at
+ */
+void SyncEngine::end_clip(const char* why, uint32_t songMs) {
+  recording_ = false;
+  pauseActive_ = false;
+  queue_camera(false, false);
+  hooks_.log_clip_end(filename_, songMs);
+  say("[SONG] -> GoPro STOP (%s)", why);
+}
+
+/**
+ * Auto-record entire song when playback is active.
+ * @brief Manages recording start/stop based on playback state and song timing.
+ *        Starts recording at song start, stops at song end or if playback is
+ *        paused for longer than the pause hold. Shorter pauses are logged as
+ *        a CLIP_GAP marker and the clip keeps recording.
+ */
+void SyncEngine::tick() {
+  // A held recent-track re-send that nothing superseded is a real change.
+  // Song times since it arrived were the held track's, so the running clip
+  // ends where it was when the re-send came in.
+  if (pendingValid_ && (int32_t)(hooks_.now_ms() - pendingDeadline_) >= 0) {
+    pendingValid_ = false;
+    apply_track(pending_, pendingKey_, pendingSongMs_);
+  }
+
+  if (!hasMeta_ || recovering_) return;
+
+  // If paused/stopped, stop recording once the pause outlasts the hold
+  if (!playing_ && recording_) {
+    uint32_t now = hooks_.now_ms();
+    if (!pauseActive_) {
+      pauseActive_ = true;
+      pausedAtMs_ = now;
+      pausedSongMs_ = songTimeMs_;
+    }
+    if (now - pausedAtMs_ >= pauseHoldMs_) {
+      end_clip("playback stopped", pausedSongMs_);
+    }
+    return;
+  }
+
+  // Resumed within the hold: one continuous clip with a gap marker
+  if (playing_ && recording_ && pauseActive_) {
+    pauseActive_ = false;
+    stats_.pausesBridged++;
+    uint32_t pauseMs = hooks_.now_ms() - pausedAtMs_;
+    if (hooks_.log_clip_gap)
+      hooks_.log_clip_gap(filename_, pausedSongMs_, songTimeMs_, pauseMs);
+    say("[SONG] pause of %u ms bridged", (unsigned)pauseMs);
+  }
+
+  // While a track is held the song time may already be the held track's:
+  // no clip starts or ends on it
+  if (pendingValid_) return;
+
+  // Start recording near the beginning once playback is playing
+  if (playing_ && !recording_) {
+    // "start condition": we are playing and time is near start (or we just started)
+    if (songTimeMs_ <= SYNC_START_WINDOW_MS) {
+      recording_ = true;
+      clipStartMs_ = songTimeMs_;
+      checkpointAtMs_ = hooks_.now_ms();
+      checkpointSongMs_ = songTimeMs_;
+      queue_camera(true, false);
+      hooks_.log_clip_start(filename_, songTimeMs_);
+      say("[SONG] -> GoPro START (song begin)");
+    }
+  }
+
+  // Stop recording at song end
+  if (recording_ && song_.durationMs > 0) {
+    if (songTimeMs_ + 200 >= song_.durationMs) {  // small margin
+      end_clip("song end", songTimeMs_);
+    }
+  }
+
+  // Persist song time periodically so a reset can close the clip
+  if (recording_ && playing_ && hooks_.log_clip_at) {
+    uint32_t now = hooks_.now_ms();
+    if (now - checkpointAtMs_ >= SYNC_CHECKPOINT_MS && songTimeMs_ != checkpointSongMs_) {
+      checkpointAtMs_ = now;
+      checkpointSongMs_ = songTimeMs_;
+      hooks_.log_clip_at(filename_, songTimeMs_);
+    }
+  }
+}
+
+/**
+ * Execute deferred shutter commands in the order they were issued.
+ * @brief Runs in main task context. A command leaves the queue only once
+ *        camera_state() reports the camera ready and shutter() takes it, so
+ *        commands issued while it is joining or busy can still cancel out in
+ *        queue_camera(). The platform reports the camera's answer. A START
+ *        that waited SYNC_CAMERA_DOWN_MS while the camera was down is dropped
+ *        (the clip would start far too late); STOPs always wait. A START and
+ *        STOP pair collapses, so the clip an expired START opened is still
+ *        the open one: it is logged as lost and ends without a STOP.
+ */
+void SyncEngine::service_camera() {
+  while (cameraCount_ > 0) {
+    int state = hooks_.camera_state ? hooks_.camera_state() : SYNC_CAMERA_READY;
+    CameraCmd cmd = camera_[0];
+    if (state == SYNC_CAMERA_READY) {
+      if (!hooks_.shutter(cmd.on)) return;  // not taken; retry next pass
+    } else {
+      if (state != SYNC_CAMERA_DOWN || !cmd.on) return;
+      if (hooks_.now_ms() - cmd.at < SYNC_CAMERA_DOWN_MS) return;
+    }
+
+    int n = cameraCount_ - 1;
+    memmove(&camera_[0], &camera_[1], n * sizeof(camera_[0]));
+    cameraCount_ = n;
+
+    if (state != SYNC_CAMERA_READY) {
+      stats_.shutterExpired++;
+      if (cameraCount_ > 0 && !camera_[0].on) {  // its STOP, if already queued
+        cameraCount_--;
+        memmove(&camera_[0], &camera_[1], cameraCount_ * sizeof(camera_[0]));
+      }
+      if (recording_) {
+        recording_ = false;
+        pauseActive_ = false;
+        if (hooks_.log_clip_lost) hooks_.log_clip_lost(filename_, clipStartMs_);
+      }
+      say("[GoPro] rec START expired (camera down), clip %s not recorded", filename_);
+      continue;
+    }
+    say("[GoPro] rec %s dispatched", cmd.on ? "START" : "STOP");
+  }
+}
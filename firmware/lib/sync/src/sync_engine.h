@@ -0,0 +1,160 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+struct LogTail;  // timeline.h
+
+struct SongMeta {
+  char uri[192];
+  char title[96];
+  uint32_t durationMs;
+};
+
+/**
+ * Platform services the sync state machine calls out to. The firmware wires
+ * these to millis()/LittleFS/GoPro HTTP; host tools wire virtual time, an
+ * in-memory log and a fake camera.
+ */
+struct SyncHooks {
+  uint32_t (*now_ms)();
+  void (*log_song)(const char* uri, const char* title, uint32_t durationMs);
+  void (*log_clip_start)(const char* file, uint32_t songMs);
+  void (*log_clip_end)(const char* file, uint32_t songMs);
+  void (*log_clip_gap)(const char* file, uint32_t fromMs, uint32_t toMs, uint32_t pauseMs);
+  void (*log_clip_at)(const char* file, uint32_t songMs);         // checkpoint
+  void (*log_clip_recovered)(const char* file, uint32_t songMs);  // reset-closed end
+  void (*log_clip_lost)(const char* file, uint32_t songMs);       // START expired, may be null
+  bool (*shutter)(bool on);         // hand one command over; false if not taken
+  void (*print)(const char* line);  // diagnostics, may be null
+  int (*camera_state)();            // may be null (always ready), see SyncCamera
+};
+
+/**
+ * camera_state() answers. Shutter commands stay in the engine's queue, where
+ * cancelling pairs collapse, until the camera can take them.
+ */
+enum SyncCamera {
+  SYNC_CAMERA_DOWN = -1,   // unreachable: hold, STARTs expire
+  SYNC_CAMERA_BUSY = 0,    // joining, or a command still in flight: hold
+  SYNC_CAMERA_READY = 1,
+};
+
+/**
+ * Metadata handling counters (monitoring).
+ */
+struct SyncStats {
+  uint32_t metaApplied;    // real track changes
+  uint32_t metaDuplicate;  // same track re-sent (reconnect / state refresh)
+  uint32_t metaStale;      // recent track re-sent then superseded; dropped
+  uint32_t metaDeferred;   // recent track held for SYNC_STALE_WINDOW_MS
+  uint32_t pausesBridged;  // pauses shorter than the hold, kept in one clip
+  uint32_t shutterPairsCancelled;  // start/stop pairs collapsed before dispatch
+  uint32_t shutterExpired; // STARTs dropped after SYNC_CAMERA_DOWN_MS unreachable (clip lost)
+  uint32_t clipsRecovered; // clips left open by a reset, closed at boot
+  uint32_t clipsResumed;   // ...or resumed because the camera kept recording
+};
+
+static const int SYNC_RECENT_TRACKS = 8;
+static const uint32_t SYNC_START_WINDOW_MS = 1500;  // a clip starts only this close to 0
+static const uint32_t SYNC_STALE_WINDOW_MS = 1000;
+static const uint32_t SYNC_PAUSE_HOLD_MS = 1500;  // default pause hysteresis
+// A skip back to the previous track is held for the stale window; it must
+// still be inside the start window (plus a few 150 ms updates) when applied.
+static_assert(SYNC_STALE_WINDOW_MS + 300 <= SYNC_START_WINDOW_MS,
+              "held track would miss its clip start");
+static const int SYNC_CAMERA_QUEUE = 4;
+static const uint32_t SYNC_CAMERA_DOWN_MS = 5000;  // max age of a START while down
+static const uint32_t SYNC_CHECKPOINT_MS = 10000;  // CLIP_AT period while recording
+
+/**
+ * "Whole song" mode: records the camera while a song with metadata plays,
+ * stops on pause, track change or song end.
+ * @brief Not thread-safe: every method runs on the main loop. The firmware
+ *        queues BLE writes in its inbox and feeds them in from loop(), with
+ *        their arrival time for set_time().
+ */
+class SyncEngine {
+ public:
+  SyncEngine();
+
+  void begin(const SyncHooks& hooks);
+
+  // Inputs
+  void set_time(uint32_t ms);
+  void set_time(uint32_t ms, uint32_t atMs);  // atMs: now_ms() when it arrived
+  void set_metadata(char* payload);  // "uri=...;title=...;dur=..." (modified)
+  void set_playing(bool playing);
+  void set_pause_hold(uint32_t ms);  // 0 = stop on every pause
+  bool handle_command(char* line);   // 'm' / 'p' lines; false if not ours
+
+  // Crash recovery: restore a clip a reset left open, then either resume it
+  // (camera still recording) or close it at its last persisted song time.
+  void recover(const SongMeta* meta, const char* file, uint32_t lastSongMs);
+  bool recover(const LogTail& tail);  // true: ask the camera, then finish_recovery()
+  void finish_recovery(bool cameraRecording);
+
+  // Main-loop work
+  void tick();            // whole-song scheduler
+  void service_camera();  // run deferred shutter commands
+
+  // State
+  const SongMeta& song() const { return song_; }
+  uint32_t song_time() const { return songTimeMs_; }
+  uint32_t interpolated_time() const;  // song time advanced to now while playing
+  bool playing() const { return playing_; }
+  bool has_meta() const { return hasMeta_; }
+  bool recording() const { return recording_; }
+  const char* clip_file() const { return filename_; }
+  const SyncStats& stats() const { return stats_; }
+  uint32_t pause_hold() const { return pauseHoldMs_; }
+  bool holding() const { return pauseActive_; }  // paused, clip kept open
+  bool recovering() const { return recovering_; }
+
+ private:
+  void end_clip(const char* why, uint32_t songMs);
+  void queue_camera(bool on, bool split);
+  void apply_track(const SongMeta& meta, uint32_t key, uint32_t endSongMs);
+  bool recently_replaced(uint32_t key) const;
+  void remember_replaced(uint32_t key);
+  void say(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+  SyncHooks hooks_;
+  SongMeta song_;
+  volatile uint32_t songTimeMs_;
+  volatile uint32_t songTimeAtMs_;  // now_ms() when songTimeMs_ arrived
+  volatile bool playing_;     // set by p1/p0 from phone
+  bool hasMeta_;              // set after metadata received
+  bool recording_;            // are we recording this song?
+  char filename_[64];         // filename used for clip start/end
+  uint32_t clipStartMs_;      // song time the open clip started at
+
+  // Idempotent metadata: current track key, last raw payload, recent tracks
+  uint32_t trackKey_;         // hash of uri + duration
+  uint32_t rawHash_;          // hash of the last raw payload
+  struct RecentTrack { uint32_t key; uint32_t replacedAtMs; };
+  RecentTrack recent_[SYNC_RECENT_TRACKS];
+  int recentCount_;
+  bool pendingValid_;         // deferred recent-track metadata
+  SongMeta pending_;
+  uint32_t pendingKey_;
+  uint32_t pendingDeadline_;
+  uint32_t pendingSongMs_;    // song time of the running track when held
+  SyncStats stats_;
+
+  // Pause hysteresis
+  uint32_t pauseHoldMs_;
+  bool pauseActive_;          // paused while recording, clip still open
+  uint32_t pausedAtMs_;
+  uint32_t pausedSongMs_;
+
+  // Checkpoints and crash recovery
+  uint32_t checkpointAtMs_;
+  uint32_t checkpointSongMs_;
+  bool recovering_;           // restored open clip awaiting finish_recovery()
+  uint32_t recoverSongMs_;
+
+  // GoPro commands in issue order, handed to the Wi-Fi task once it can take them
+  struct CameraCmd { bool on; bool split; uint32_t at; };
+  CameraCmd camera_[SYNC_CAMERA_QUEUE];
+  volatile int cameraCount_;
+};
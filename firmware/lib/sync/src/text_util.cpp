@@ -0,0 +1,77 @@
+#include "text_util.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Safe string copy with null termination.
+ * @param dst Destination buffer
+ * @param dst_sz Size of destination buffer (including null terminator)
+ * @param src Source string (can be NULL)
+ * @brief Safely copies src to dst with bounds checking and null termination
+ */
+void safe_copy(char* dst, size_t dst_sz, const char* src) {
+  if (!dst || dst_sz == 0) return;
+  if (!src) { dst[0] = '\0'; return; }
+  strncpy(dst, src, dst_sz - 1);
+  dst[dst_sz - 1] = '\0';
+}
+
+/**
+ * Trim leading and trailing whitespace from a string in-place.
+ * @param s String to trim (modifies in place)
+ * @brief Removes all leading and trailing whitespace characters
+ */
+void trim_inplace(char* s) {
+  if (!s) return;
+  char* p = s;
+  while (*p && isspace((unsigned char)*p)) p++;
+  if (p != s) memmove(s, p, strlen(p) + 1);
+  size_t n = strlen(s);
+  while (n > 0 && isspace((unsigned char)s[n - 1])) {
+    s[n - 1] = '\0';
+    n--;
+  }
+}
+
+/**
+ * Parse unsigned 32-bit integer from string.
+ * @param s Input string (can be NULL)
+ * @return Parsed value, or 0 if string is NULL or invalid
+ * @brief Converts decimal string to uint32_t
+ */
+uint32_t parse_u32(const char* s) {
+  if (!s) return 0;
+  return (uint32_t)strtoul(s, nullptr, 10);
+}
+
+/**
+ * Check if all bytes in a buffer are ASCII digits.
+ * @param d Data buffer
+ * @param n Number of bytes to check
+ * @return true if all bytes are '0'-'9', false otherwise
+ * @brief Used to distinguish time commands (digits) from text commands
+ */
+bool is_all_digits(const uint8_t* d, size_t n) {
+  if (!d || n == 0) return false;
+  for (size_t i = 0; i < n; i++)
+    if (d[i] < '0' || d[i] > '9') return false;
+  return true;
+}
+
+/**
+ * Check if all bytes are printable ASCII (space-tilde, plus tab/CR/LF).
+ * @param d Data buffer
+ * @param n Number of bytes to check
+ * @return true if all bytes are printable ASCII, false if contains control chars
+ * @brief Validates BLE data before parsing as text commands
+ */
+bool is_printable_ascii(const uint8_t* d, size_t n) {
+  if (!d || n == 0) return false;
+  for (size_t i = 0; i < n; i++) {
+    uint8_t c = d[i];
+    if (c == '\r' || c == '\n' || c == '\t') continue;
+    if (c < 32 || c > 126) return false;
+  }
+  return true;
+}
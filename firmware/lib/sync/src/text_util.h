@@ -0,0 +1,9 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+void safe_copy(char* dst, size_t dst_sz, const char* src);
+void trim_inplace(char* s);
+uint32_t parse_u32(const char* s);
+bool is_all_digits(const uint8_t* d, size_t n);
+bool is_printable_ascii(const uint8_t* d, size_t n);
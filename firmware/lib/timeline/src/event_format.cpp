@@ -0,0 +1,122 @@
+#include "event_format.h"
+#include <stdio.h>
+
+/**
+ * Clamp an snprintf result to the number of bytes actually in the buffer.
+ */
+static size_t clamp_len(int n, size_t cap) {
+  if (n < 0 || cap == 0) return 0;
+  return (size_t)n < cap ? (size_t)n : cap - 1;
+}
+
+/**
+ * Format a SONG line.
+ * @param out Output buffer
+ * @param cap Size of output buffer
+ * @param uri Song URI
+ * @param title Song title
+ * @param durationMs Song duration in milliseconds
+ * @return Line length (excluding the terminator)
+ */
+size_t format_song_line(char* out, size_t cap, const char* uri, const char* title,
+                        uint32_t durationMs) {
+  return clamp_len(snprintf(out, cap, "SONG uri=\"%s\" title=\"%s\" durationMs=%lu",
+                            uri, title, (unsigned long)durationMs), cap);
+}
+
+/**
+ * Format a CLIP_START line.
+ * @param out Output buffer
+ * @param cap Size of output buffer
+ * @param file Video filename
+ * @param songMs Song time when recording started
+ * @return Line length (excluding the terminator)
+ */
+size_t format_clip_start_line(char* out, size_t cap, const char* file, uint32_t songMs) {
+  return clamp_len(snprintf(out, cap, "CLIP_START file=\"%s\" songMs=%lu",
+                            file, (unsigned long)songMs), cap);
+}
+
+/**
+ * Format a CLIP_END line.
+ * @param out Output buffer
+ * @param cap Size of output buffer
+ * @param file Video filename
+ * @param songMs Song time when recording stopped
+ * @return Line length (excluding the terminator)
+ */
+size_t format_clip_end_line(char* out, size_t cap, const char* file, uint32_t songMs) {
+  return clamp_len(snprintf(out, cap, "CLIP_END file=\"%s\" songMs=%lu",
+                            file, (unsigned long)songMs), cap);
+}
+
+/**
+ * Format a CLIP_AT checkpoint (song time persisted while recording).
+ * @param out Output buffer
+ * @param cap Size of output buffer
+ * @param file Video filename of the open clip
+ * @param songMs Song time in milliseconds
+ * @return Line length (excluding the terminator)
+ */
+size_t format_clip_at_line(char* out, size_t cap, const char* file, uint32_t songMs) {
+  return clamp_len(snprintf(out, cap, "CLIP_AT file=\"%s\" songMs=%lu",
+                            file, (unsigned long)songMs), cap);
+}
+
+/**
+ * Format the CLIP_END that closes a clip left open by a reset.
+ * @param out Output buffer
+ * @param cap Size of output buffer
+ * @param file Video filename of the recovered clip
+ * @param songMs Last persisted song time of the clip
+ * @return Line length (excluding the terminator)
+ */
+size_t format_clip_recovered_line(char* out, size_t cap, const char* file, uint32_t songMs) {
+  return clamp_len(snprintf(out, cap, "CLIP_END file=\"%s\" songMs=%lu recovered=1",
+                            file, (unsigned long)songMs), cap);
+}
+
+/**
+ * Format a CLIP_LOST line: the camera never started the open clip.
+ * @param out Output buffer
+ * @param cap Size of output buffer
+ * @param file Video filename of the open clip
+ * @param songMs Song time the clip was logged as starting at
+ * @return Line length (excluding the terminator)
+ */
+size_t format_clip_lost_line(char* out, size_t cap, const char* file, uint32_t songMs) {
+  return clamp_len(snprintf(out, cap, "CLIP_LOST file=\"%s\" songMs=%lu",
+                            file, (unsigned long)songMs), cap);
+}
+
+/**
+ * Format a CLIP_GAP marker (brief pause bridged inside one clip).
+ * @param out Output buffer
+ * @param cap Size of output buffer
+ * @param file Video filename of the clip that kept recording
+ * @param fromMs Song time when playback paused
+ * @param toMs Song time when playback resumed
+ * @param pauseMs Wall-clock length of the pause
+ * @return Line length (excluding the terminator)
+ */
+size_t format_clip_gap_line(char* out, size_t cap, const char* file, uint32_t fromMs,
+                            uint32_t toMs, uint32_t pauseMs) {
+  return clamp_len(snprintf(out, cap, "CLIP_GAP file=\"%s\" fromMs=%lu toMs=%lu pauseMs=%lu",
+                            file, (unsigned long)fromMs, (unsigned long)toMs,
+                            (unsigned long)pauseMs), cap);
+}
+
+/**
+ * Format the device / sequence / time trailer appended to a log line.
+ * @param out Output buffer
+ * @param cap Size of output buffer
+ * @param dev Device ID (no spaces)
+ * @param seq Per-device sequence number of this line
+ * @param bootMs Milliseconds since the device booted
+ * @return Trailer length (excluding the terminator), including the leading space
+ */
+size_t format_event_stamp(char* out, size_t cap, const char* dev, uint32_t seq,
+                          uint32_t bootMs) {
+  return clamp_len(snprintf(out, cap, " dev=%s seq=%lu t=%lu", dev,
+                            (unsigned long)seq, (unsigned long)bootMs), cap);
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  events.log line format (the writer side of TimelineParser). Shared by the
+  firmware logger and host tools so both produce identical logs.
+  Lines are returned without the trailing newline.
+*/
+static const size_t EVENT_LINE_MAX = 384;      // longest body: SONG with full uri and title
+static const size_t EVENT_STAMP_MAX = 48;      // " dev=ID seq=N t=MS"
+static const size_t EVENT_LOG_LINE_MAX = 512;  // reader buffers: body + stamp + CRLF
+static_assert(EVENT_LINE_MAX + EVENT_STAMP_MAX + 2 <= EVENT_LOG_LINE_MAX,
+              "log readers must hold the longest line the logger writes");
+
+size_t format_song_line(char* out, size_t cap, const char* uri, const char* title,
+                        uint32_t durationMs);
+size_t format_clip_start_line(char* out, size_t cap, const char* file, uint32_t songMs);
+size_t format_clip_end_line(char* out, size_t cap, const char* file, uint32_t songMs);
+size_t format_clip_at_line(char* out, size_t cap, const char* file, uint32_t songMs);
+size_t format_clip_recovered_line(char* out, size_t cap, const char* file, uint32_t songMs);
+size_t format_clip_lost_line(char* out, size_t cap, const char* file, uint32_t songMs);
+size_t format_clip_gap_line(char* out, size_t cap, const char* file, uint32_t fromMs,
+                            uint32_t toMs, uint32_t pauseMs);
+
+// Trailer the logger appends to every line (" dev=ID seq=N t=MS"): device ID,
+// per-device sequence number and boot-relative time, so logs from several
+// rigs can be merged. Readers find it with parse_event_stamp().
+size_t format_event_stamp(char* out, size_t cap, const char* dev, uint32_t seq,
+                          uint32_t bootMs);
@@ -0,0 +1,576 @@
+#include "songtime_trace.h"
+#include <string.h>
+
+/*
+  ENCODING
+*/
+static uint32_t zigzag(int32_t v) {
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v) {
+  return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static size_t put_varint(uint8_t* p, uint32_t v) {
+  size_t n = 0;
+  while (v >= 0x80) {
+    p[n++] = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  p[n++] = (uint8_t)v;
+  return n;
+}
+
+static bool get_varint(const uint8_t** p, const uint8_t* end, uint32_t* out) {
+  uint32_t v = 0;
+  for (int shift = 0; shift < 35 && *p < end; shift += 7) {
+    uint8_t b = *(*p)++;
+    v |= (uint32_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) {
+      *out = v;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void put_u16(uint8_t* p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t* p, uint32_t v) {
+  for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static uint16_t get_u16(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * Start an empty block.
+ * @param bootSeq events.log seq of the boot the samples belong to
+ */
+void SongTimeEncoder::reset(uint32_t bootSeq) {
+  fill_ = SONGTIME_HEADER_BYTES;
+  count_ = 0;
+  bootSeq_ = bootSeq;
+  firstLocal_ = firstSong_ = 0;
+  lastLocal_ = lastSong_ = 0;
+  dLocal_ = dSong_ = 0;
+}
+
+/**
+ * Append one song-time update.
+ * @param localMs millis() when it arrived
+ * @param songMs Song time the phone sent
+ * @return false if the block has no room left (sample not added)
+ * @brief The first sample goes into the header as the keyframe. Later ones
+ *        store how much the local and song deltas changed, which is zero
+ *        for both at a steady update rate.
+ */
+bool SongTimeEncoder::add(uint32_t localMs, uint32_t songMs) {
+  if (count_ == 0) {
+    firstLocal_ = lastLocal_ = localMs;
+    firstSong_ = lastSong_ = songMs;
+    dLocal_ = dSong_ = 0;
+    count_ = 1;
+    return true;
+  }
+  if (count_ == 0xFFFF) return false;
+
+  int32_t dl = (int32_t)(localMs - lastLocal_);
+  int32_t ds = (int32_t)(songMs - lastSong_);
+  uint32_t za = zigzag((int32_t)((uint32_t)dl - (uint32_t)dLocal_));
+  uint32_t zb = zigzag((int32_t)((uint32_t)ds - (uint32_t)dSong_));
+
+  uint8_t tmp[11];
+  size_t n;
+  if (zb == 0 && za < 0x80) {
+    tmp[0] = (uint8_t)za;
+    n = 1;
+  } else if (za < 0x40 && zb < 0x100) {
+    tmp[0] = (uint8_t)(0x80 | za);
+    tmp[1] = (uint8_t)zb;
+    n = 2;
+  } else {
+    tmp[0] = 0xC0;
+    n = 1;
+    n += put_varint(tmp + n, za);
+    n += put_varint(tmp + n, zb);
+  }
+  if (fill_ + n > sizeof(buf_)) return false;
+
+  memcpy(buf_ + fill_, tmp, n);
+  fill_ += n;
+  count_++;
+  lastLocal_ = localMs;
+  lastSong_ = songMs;
+  dLocal_ = dl;
+  dSong_ = ds;
+  return true;
+}
+
+/**
+ * The block as it goes to flash.
+ * @return Header + payload, size() bytes
+ */
+const uint8_t* SongTimeEncoder::data() {
+  buf_[0] = SONGTIME_MAGIC;
+  buf_[1] = SONGTIME_VERSION;
+  put_u16(buf_ + 2, (uint16_t)(fill_ - SONGTIME_HEADER_BYTES));
+  put_u16(buf_ + 4, count_);
+  put_u32(buf_ + 6, bootSeq_);
+  put_u32(buf_ + 10, firstLocal_);
+  put_u32(buf_ + 14, firstSong_);
+  put_u32(buf_ + 18, lastLocal_);
+  return buf_;
+}
+
+/**
+ * Read a block header.
+ * @param data Block bytes
+ * @param len Bytes available (at least the header)
+ * @param out Receives the header fields
+ * @return false if data doesn't start with a valid header
+ */
+bool songtime_parse_header(const uint8_t* data, size_t len, SongTimeBlock* out) {
+  if (len < SONGTIME_HEADER_BYTES) return false;
+  if (data[0] != SONGTIME_MAGIC || data[1] != SONGTIME_VERSION) return false;
+  out->payloadBytes = get_u16(data + 2);
+  out->count = get_u16(data + 4);
+  out->bootSeq = get_u32(data + 6);
+  out->localMs = get_u32(data + 10);
+  out->songMs = get_u32(data + 14);
+  out->lastLocalMs = get_u32(data + 18);
+  return out->payloadBytes <= SONGTIME_BLOCK_MAX - SONGTIME_HEADER_BYTES;
+}
+
+/**
+ * Decode a whole block.
+ * @param data Header + payload
+ * @param len Bytes available
+ * @param visit Called for each sample in order
+ * @param ctx Passed through to visit
+ * @return Samples delivered
+ */
+int songtime_decode_block(const uint8_t* data, size_t len, SongTimeVisit visit, void* ctx) {
+  SongTimeBlock b;
+  if (!songtime_parse_header(data, len, &b) || !b.count) return 0;
+  if (len > SONGTIME_HEADER_BYTES + b.payloadBytes) len = SONGTIME_HEADER_BYTES + b.payloadBytes;
+
+  SongTimeSample s = {b.localMs, b.songMs};
+  visit(s, ctx);
+  int n = 1;
+
+  const uint8_t* p = data + SONGTIME_HEADER_BYTES;
+  const uint8_t* end = data + len;
+  uint32_t dl = 0, ds = 0;
+  for (; n < b.count && p < end; n++) {
+    uint8_t tag = *p++;
+    uint32_t za = 0, zb = 0;
+    if (!(tag & 0x80)) {
+      za = tag;
+    } else if ((tag & 0xC0) == 0x80) {
+      if (p >= end) break;
+      za = tag & 0x3F;
+      zb = *p++;
+    } else if (tag == 0xC0) {
+      if (!get_varint(&p, end, &za) || !get_varint(&p, end, &zb)) break;
+    } else {
+      break;
+    }
+    dl += (uint32_t)unzigzag(za);
+    ds += (uint32_t)unzigzag(zb);
+    s.localMs += dl;
+    s.songMs += ds;
+    visit(s, ctx);
+  }
+  return n;
+}
+
+/*
+  STORE POLICY
+*/
+SongTimeStore::SongTimeStore()
+    : keepCur_(false), bootSeq_(0), idleLen_(0), outLen_(0),
+      samples_(0), skipped_(0), dropped_(0) {}
+
+/**
+ * Start the trace of a new boot.
+ * @param bootSeq events.log seq at boot (seq of the last line before it)
+ * @brief Queues an empty block so readers can tell boots apart even when
+ *        nothing was recorded in one.
+ */
+void SongTimeStore::begin(uint32_t bootSeq) {
+  bootSeq_ = bootSeq;
+  keepCur_ = false;
+  idleLen_ = 0;
+  enc_.reset(bootSeq);
+  queue(enc_.data(), enc_.size());
+}
+
+/**
+ * Record one song-time update.
+ * @param localMs millis() when it arrived
+ * @param songMs Song time the phone sent
+ */
+void SongTimeStore::add(uint32_t localMs, uint32_t songMs) {
+  samples_++;
+  if (keepCur_ && enc_.count() && localMs - enc_.first_local() >= SONGTIME_KEPT_SPAN_MS)
+    finish_block();
+  if (enc_.add(localMs, songMs)) return;
+  finish_block();
+  enc_.add(localMs, songMs);
+}
+
+/**
+ * Close the open block now (e.g. before an export reads the file).
+ */
+void SongTimeStore::flush() {
+  finish_block();
+}
+
+/**
+ * Move the open block to the write queue, or hold it back if idle.
+ */
+void SongTimeStore::finish_block() {
+  if (!enc_.count()) return;
+  const uint8_t* data = enc_.data();
+  size_t len = enc_.size();
+  if (keepCur_) {
+    if (idleLen_) queue(idle_, idleLen_);
+    idleLen_ = 0;
+    queue(data, len);
+  } else {
+    if (idleLen_) skipped_++;
+    memcpy(idle_, data, len);
+    idleLen_ = len;
+  }
+  enc_.reset(bootSeq_);
+  keepCur_ = false;
+}
+
+void SongTimeStore::queue(const uint8_t* data, size_t len) {
+  if (outLen_ + len > sizeof(out_)) {
+    dropped_ += (uint32_t)len;
+    return;
+  }
+  memcpy(out_ + outLen_, data, len);
+  outLen_ += len;
+}
+
+/**
+ * Take bytes that are ready to be appended to the file.
+ * @param out Destination
+ * @param cap Size of out
+ * @return Bytes copied; the rest stays queued
+ */
+size_t SongTimeStore::take(uint8_t* out, size_t cap) {
+  size_t n = outLen_ < cap ? outLen_ : cap;
+  memcpy(out, out_, n);
+  memmove(out_, out_ + n, outLen_ - n);
+  outLen_ -= n;
+  return n;
+}
+
+/*
+  CLIP REFINEMENT
+*/
+/**
+ * Start refining a parsed timeline.
+ * @param tl Timeline to update in place (clips must carry their log stamps)
+ */
+void SongTimeRefiner::begin(Timeline* tl) {
+  tl_ = tl;
+  bootCount_ = 0;
+  mapped_ = false;
+  pointCount_ = 0;
+  curBoot_ = -1;
+  havePrev_ = false;
+  stalling_ = false;
+  stallFrom_ = 0;
+  memset(&prev_, 0, sizeof(prev_));
+  memset(&stats_, 0, sizeof(stats_));
+  for (int i = 0; i < tl_->clipCount; i++) {
+    const TimelineClip& c = tl_->clips[i];
+    clipStartBoot_[i] = clipEndBoot_[i] = -1;
+    for (int end = 0; end < 2; end++) {
+      uint32_t seq = end ? c.endSeq : c.startSeq;
+      if (!seq) continue;
+      Point& p = points_[pointCount_++];
+      memset(&p, 0, sizeof(p));
+      p.clip = i;
+      p.start = !end;
+      p.seq = seq;
+      p.t = end ? c.endT : c.startT;
+      p.boot = -1;
+    }
+  }
+}
+
+/**
+ * First pass: note which boot every block belongs to.
+ * @param b Block header, in file order
+ */
+void SongTimeRefiner::header(const SongTimeBlock& b) {
+  stats_.blocks++;
+  if (bootCount_ && boots_[bootCount_ - 1] == b.bootSeq) return;
+  if (bootCount_ == MAX_BOOTS) {
+    memmove(boots_, boots_ + 1, sizeof(boots_[0]) * (MAX_BOOTS - 1));
+    bootCount_--;
+  }
+  boots_[bootCount_++] = b.bootSeq;
+}
+
+/**
+ * Boot a log line was written in: the last one that started before it.
+ * @param seq Stamp seq of the line
+ * @return Index into boots_, or -1
+ */
+int SongTimeRefiner::boot_of(uint32_t seq) const {
+  int found = -1;
+  for (int i = 0; i < bootCount_; i++)
+    if (boots_[i] < seq) found = i;
+  return found;
+}
+
+void SongTimeRefiner::map_boots() {
+  mapped_ = true;
+  for (int i = 0; i < pointCount_; i++) {
+    Point& p = points_[i];
+    p.boot = boot_of(p.seq);
+    if (p.start) clipStartBoot_[p.clip] = p.boot;
+    else clipEndBoot_[p.clip] = p.boot;
+  }
+}
+
+/**
+ * Clip being recorded at a local time of the current boot.
+ * @param localMs Sample time
+ * @param offsetMs Receives the position inside the clip
+ * @return Clip index, or -1
+ */
+int SongTimeRefiner::clip_at(uint32_t localMs, uint32_t* offsetMs) const {
+  for (int i = 0; i < tl_->clipCount; i++) {
+    const TimelineClip& c = tl_->clips[i];
+    int sb = clipStartBoot_[i];
+    int eb = clipEndBoot_[i];
+    if (sb < 0) continue;
+    uint32_t lengthMs = c.endMs > c.startMs ? c.endMs - c.startMs : 0;
+    uint32_t endT = c.endT;
+    if (eb < 0) {
+      eb = sb;
+      endT = c.startT + lengthMs;
+    }
+    if (curBoot_ < sb || curBoot_ > eb) continue;
+    if (curBoot_ == sb && localMs < c.startT) continue;
+    if (curBoot_ == eb && localMs > endT) continue;
+
+    if (curBoot_ == sb) *offsetMs = localMs - c.startT;
+    else if (curBoot_ == eb) *offsetMs = lengthMs > endT - localMs ? lengthMs - (endT - localMs) : 0;
+    else *offsetMs = 0;
+    return i;
+  }
+  return -1;
+}
+
+/**
+ * Second pass: decide whether a block is worth reading.
+ * @param b Block header, in file order
+ * @return true if it has samples near a clip boundary or inside a clip
+ */
+bool SongTimeRefiner::want(const SongTimeBlock& b) {
+  if (!mapped_) map_boots();
+  curBoot_ = -1;
+  for (int i = bootCount_ - 1; i >= 0 && curBoot_ < 0; i--)
+    if (boots_[i] == b.bootSeq) curBoot_ = i;
+
+  bool wanted = false;
+  if (curBoot_ >= 0 && b.count) {
+    uint32_t lo = b.localMs > SONGTIME_BRACKET_MS ? b.localMs - SONGTIME_BRACKET_MS : 0;
+    uint32_t hi = b.lastLocalMs + SONGTIME_BRACKET_MS;
+    for (int i = 0; i < pointCount_ && !wanted; i++) {
+      const Point& p = points_[i];
+      wanted = p.boot == curBoot_ && p.t >= lo && p.t <= hi;
+    }
+    uint32_t off;
+    wanted = wanted || clip_at(b.localMs, &off) >= 0 || clip_at(b.lastLocalMs, &off) >= 0;
+  }
+  if (!wanted) {
+    // Samples on either side of a skipped block aren't neighbours
+    if (havePrev_) end_stall(prev_.localMs);
+    havePrev_ = false;
+  }
+  return wanted;
+}
+
+/**
+ * Decode a block want() accepted.
+ * @param data Header + payload
+ * @param len Bytes available
+ */
+void SongTimeRefiner::block(const uint8_t* data, size_t len) {
+  stats_.blocksDecoded++;
+  songtime_decode_block(data, len, visit, this);
+}
+
+void SongTimeRefiner::visit(const SongTimeSample& s, void* ctx) {
+  static_cast<SongTimeRefiner*>(ctx)->sample(s);
+}
+
+void SongTimeRefiner::add_mark(uint8_t kind, uint32_t localMs, uint32_t lengthMs) {
+  uint32_t off;
+  int clip = clip_at(localMs, &off);
+  if (clip < 0 || tl_->markCount >= TIMELINE_MAX_MARKS) return;
+  TimelineMark& m = tl_->marks[tl_->markCount++];
+  m.clip = (uint8_t)clip;
+  m.kind = kind;
+  m.offsetMs = off;
+  m.lengthMs = lengthMs;
+  stats_.marks++;
+}
+
+/**
+ * Close a run of updates where the song time didn't move.
+ * @param localMs Last sample of the run
+ */
+void SongTimeRefiner::end_stall(uint32_t localMs) {
+  if (stalling_ && localMs - stallFrom_ >= SONGTIME_STALL_MS)
+    add_mark(MARK_STALL, stallFrom_, localMs - stallFrom_);
+  stalling_ = false;
+}
+
+/**
+ * One decoded sample of the current boot.
+ * @param s Sample
+ * @brief Keeps the samples bracketing every boundary stamp, and compares
+ *        each sample with the one before it for gaps, seeks and stalls.
+ */
+void SongTimeRefiner::sample(const SongTimeSample& s) {
+  for (int i = 0; i < pointCount_; i++) {
+    Point& p = points_[i];
+    if (p.boot != curBoot_) continue;
+    if ((int32_t)(s.localMs - p.t) <= 0) {
+      p.havePrev = true;
+      p.prev = s;
+      p.prevPlaying = havePrev_ && s.songMs != prev_.songMs;
+    } else if (!p.haveNext) {
+      p.haveNext = true;
+      p.next = s;
+    }
+  }
+
+  if (havePrev_) {
+    uint32_t dl = s.localMs - prev_.localMs;
+    int32_t ds = (int32_t)(s.songMs - prev_.songMs);
+    int32_t drift = ds - (int32_t)dl;
+    if (dl >= SONGTIME_GAP_MS) {
+      end_stall(prev_.localMs);
+      add_mark(MARK_GAP, prev_.localMs, dl);
+    } else if (ds != 0 && (drift >= (int32_t)SONGTIME_JUMP_MS || drift <= -(int32_t)SONGTIME_JUMP_MS)) {
+      end_stall(prev_.localMs);
+      add_mark(MARK_SEEK, prev_.localMs, 0);
+    } else if (ds == 0 && dl) {
+      if (!stalling_) {
+        stalling_ = true;
+        stallFrom_ = prev_.localMs;
+      }
+    } else {
+      end_stall(prev_.localMs);
+    }
+  }
+  havePrev_ = true;
+  prev_ = s;
+}
+
+/**
+ * Song time at a boundary's stamp, from the samples around it.
+ * @param p Boundary with its bracketing samples
+ * @param loggedMs Song time the log line carries
+ * @param songMs Receives the song time
+ * @return false if the trace has nothing close enough, or doesn't agree
+ *         with the line
+ * @brief The line must have been written off the latest update: a boundary
+ *        logged after the fact (a held track change, the end of a pause
+ *        hold) carries an older song time, and the samples at its stamp may
+ *        already be another track. Only a continuous pair is interpolated;
+ *        across a jump the next sample may be another track or the far side
+ *        of a seek (the trace has no track ids), so the boundary extends
+ *        from the sample before it only.
+ */
+bool SongTimeRefiner::refine(const Point& p, uint32_t loggedMs, uint32_t* songMs) const {
+  if (!p.havePrev) return false;
+  uint32_t since = p.t - p.prev.localMs;
+  if (p.prev.songMs < loggedMs || since + (p.prev.songMs - loggedMs) > SONGTIME_LAG_MS)
+    return false;
+
+  if (p.haveNext && p.next.localMs - p.prev.localMs <= SONGTIME_BRACKET_MS) {
+    uint32_t dl = p.next.localMs - p.prev.localMs;
+    int32_t ds = (int32_t)(p.next.songMs - p.prev.songMs);
+    int32_t drift = ds - (int32_t)dl;
+    if (ds >= 0 && drift < (int32_t)SONGTIME_JUMP_MS && drift > -(int32_t)SONGTIME_JUMP_MS) {
+      *songMs = p.prev.songMs + (uint32_t)((uint64_t)ds * since / dl);
+      return true;
+    }
+  }
+  *songMs = p.prev.songMs + (p.prevPlaying ? since : 0);
+  return true;
+}
+
+/**
+ * Apply the refined boundaries.
+ * @param stats Receives counters (may be null)
+ * @brief A clip keeps its logged times if a correction is implausibly large
+ *        or would leave it empty.
+ */
+void SongTimeRefiner::finish(SongTimeRefineStats* stats) {
+  if (havePrev_) end_stall(prev_.localMs);
+  if (!mapped_) map_boots();
+
+  for (int i = 0; i < pointCount_; i++) {
+    const Point& p = points_[i];
+    TimelineClip& c = tl_->clips[p.clip];
+    uint32_t orig = p.start ? c.startMs : c.endMs;
+    uint32_t v;
+    if (p.boot < 0 || !refine(p, orig, &v)) continue;
+    uint32_t shift = v > orig ? v - orig : orig - v;
+    if (!shift || shift > SONGTIME_MAX_SHIFT_MS) continue;
+    if (p.start ? v >= c.endMs : v <= c.startMs) continue;
+    if (p.start) c.startMs = v;
+    else c.endMs = v;
+    stats_.refined++;
+    if (shift > stats_.maxShiftMs) stats_.maxShiftMs = shift;
+  }
+  if (stats) *stats = stats_;
+}
+
+/**
+ * Run a refiner over a whole /songtime.bin held in memory.
+ * @param tl Parsed timeline, refined in place
+ * @param data File contents
+ * @param len File size
+ * @param stats Receives counters (may be null)
+ */
+void songtime_refine_buffer(Timeline* tl, const uint8_t* data, size_t len,
+                            SongTimeRefineStats* stats) {
+  SongTimeRefiner refiner;
+  refiner.begin(tl);
+  SongTimeBlock b;
+  // A block torn by a reset mid-append ends the file
+  for (int pass = 0; pass < 2; pass++) {
+    for (size_t off = 0; songtime_parse_header(data + off, len - off, &b); ) {
+      size_t blockLen = SONGTIME_HEADER_BYTES + b.payloadBytes;
+      if (blockLen > len - off) break;
+      if (!pass) refiner.header(b);
+      else if (refiner.want(b)) refiner.block(data + off, blockLen);
+      off += blockLen;
+    }
+  }
+  refiner.finish(stats);
+}
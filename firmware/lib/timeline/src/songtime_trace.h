@@ -0,0 +1,194 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "timeline.h"
+
+/*
+  /songtime.bin: every song-time update the phone sent, as a series of
+  blocks. A block header is a keyframe (absolute local and song time), so a
+  reader can hop from header to header and decode only the blocks it needs.
+  Samples after the keyframe are stored as the change in (local delta, song
+  delta) from the previous sample: steady playback costs 1 byte, BLE jitter
+  2 bytes, seeks and pauses 3+.
+
+  Header (little-endian, SONGTIME_HEADER_BYTES):
+    u8 'S', u8 version, u16 payloadBytes, u16 count, u32 bootSeq,
+    u32 localMs, u32 songMs, u32 lastLocalMs
+  bootSeq is the events.log seq when the device booted, which ties local
+  times (millis(), the t= of log stamps) to the log lines of that boot. A
+  block with count 0 only marks a boot.
+
+  Sample forms (a = local delta change, b = song delta change, zigzag):
+    0zzzzzzz               b = 0, a in [-64, 63]
+    10aaaaaa bbbbbbbb      a in [-32, 31], b in [-128, 127]
+    11000000 varint varint any a, b
+*/
+static const size_t SONGTIME_BLOCK_MAX = 512;
+static const size_t SONGTIME_HEADER_BYTES = 22;
+static const uint8_t SONGTIME_MAGIC = 'S';
+static const uint8_t SONGTIME_VERSION = 1;
+static const uint32_t SONGTIME_KEPT_SPAN_MS = 30000;  // longest a kept block stays in RAM
+
+struct SongTimeSample {
+  uint32_t localMs;
+  uint32_t songMs;
+};
+
+struct SongTimeBlock {
+  uint16_t payloadBytes;
+  uint16_t count;
+  uint32_t bootSeq;
+  uint32_t localMs;
+  uint32_t songMs;
+  uint32_t lastLocalMs;
+};
+
+/**
+ * Builds one block of delta-encoded samples.
+ */
+class SongTimeEncoder {
+ public:
+  SongTimeEncoder() { reset(0); }
+
+  void reset(uint32_t bootSeq);
+  bool add(uint32_t localMs, uint32_t songMs);  // false: block full, take it and reset
+  uint16_t count() const { return count_; }
+  uint32_t first_local() const { return firstLocal_; }
+  size_t size() const { return fill_; }          // header + payload
+  const uint8_t* data();                         // finalizes the header
+
+ private:
+  uint8_t buf_[SONGTIME_BLOCK_MAX];
+  size_t fill_;
+  uint16_t count_;
+  uint32_t bootSeq_;
+  uint32_t firstLocal_, firstSong_;
+  uint32_t lastLocal_, lastSong_;
+  int32_t dLocal_, dSong_;
+};
+
+// Parses a block header. false if it isn't one (bad magic / version).
+bool songtime_parse_header(const uint8_t* data, size_t len, SongTimeBlock* out);
+
+// Decodes one whole block (header + payload). Returns the number of samples
+// delivered; stops early on a malformed payload.
+typedef void (*SongTimeVisit)(const SongTimeSample& s, void* ctx);
+int songtime_decode_block(const uint8_t* data, size_t len, SongTimeVisit visit, void* ctx);
+
+/**
+ * Which blocks reach flash.
+ * @brief Samples are only worth keeping around a recording, so a finished
+ *        block is written only if recording was active while it filled; the
+ *        last idle block is held back and written just before a kept one, so
+ *        the samples leading up to a clip start survive. A kept block is
+ *        closed after SONGTIME_KEPT_SPAN_MS so a reset loses at most that
+ *        much. Not thread-safe: the firmware serializes add() and take().
+ */
+class SongTimeStore {
+ public:
+  SongTimeStore();
+
+  void begin(uint32_t bootSeq);                 // queues the boot marker
+  void add(uint32_t localMs, uint32_t songMs);
+  void mark_keep() { keepCur_ = true; }         // recording: keep the open block
+  void flush();                                 // finish the open block now
+  size_t take(uint8_t* out, size_t cap);        // bytes ready to append
+
+  uint32_t samples() const { return samples_; }
+  uint32_t blocks_skipped() const { return skipped_; }
+  uint32_t bytes_dropped() const { return dropped_; }
+
+ private:
+  void finish_block();
+  void queue(const uint8_t* data, size_t len);
+
+  SongTimeEncoder enc_;
+  bool keepCur_;
+  uint32_t bootSeq_;
+  uint8_t idle_[SONGTIME_BLOCK_MAX];
+  size_t idleLen_;
+  uint8_t out_[2 * SONGTIME_BLOCK_MAX + SONGTIME_HEADER_BYTES];
+  size_t outLen_;
+  uint32_t samples_, skipped_, dropped_;
+};
+
+/*
+  CLIP REFINEMENT
+*/
+static const uint32_t SONGTIME_GAP_MS = 1000;        // no update this long: BLE gap
+static const uint32_t SONGTIME_JUMP_MS = 1000;       // song moved this far off local time: seek
+static const uint32_t SONGTIME_STALL_MS = 500;       // song time stood still this long
+static const uint32_t SONGTIME_BRACKET_MS = 2000;    // furthest sample used for a boundary
+static const uint32_t SONGTIME_MAX_SHIFT_MS = 5000;  // larger corrections are rejected
+static const uint32_t SONGTIME_LAG_MS = 300;         // line this far behind the trace was deferred
+
+struct SongTimeRefineStats {
+  int blocks;           // blocks in the file
+  int blocksDecoded;    // blocks near a clip
+  int refined;          // clip boundaries moved
+  uint32_t maxShiftMs;  // largest move
+  int marks;            // discontinuities flagged
+};
+
+/**
+ * Re-derives clip boundaries and flags discontinuities from the trace.
+ * @brief A boundary's song time is re-read from the samples around the log
+ *        stamp of its line, interpolating between the updates before and
+ *        after it instead of using the last update as logged. Inside a clip,
+ *        a BLE gap, a song-time jump (seek) or a song time that stops
+ *        advancing (stall) becomes a TimelineMark. Call begin(), then
+ *        header() for every block, then want() and, if true, block() in the
+ *        same order, then finish(). Unstamped logs are left untouched. ~3 KB,
+ *        so the firmware keeps one static instance.
+ */
+class SongTimeRefiner {
+ public:
+  SongTimeRefiner() : tl_(nullptr) {}
+
+  void begin(Timeline* tl);
+  void header(const SongTimeBlock& b);
+  bool want(const SongTimeBlock& b);
+  void block(const uint8_t* data, size_t len);
+  void finish(SongTimeRefineStats* stats);
+
+ private:
+  struct Point {
+    int clip;
+    bool start;
+    uint32_t seq, t;
+    int boot;           // index into boots_, -1 = no trace for it
+    bool havePrev, haveNext, prevPlaying;
+    SongTimeSample prev, next;
+  };
+
+  void map_boots();
+  int boot_of(uint32_t seq) const;
+  int clip_at(uint32_t localMs, uint32_t* offsetMs) const;
+  void sample(const SongTimeSample& s);
+  void end_stall(uint32_t localMs);
+  void add_mark(uint8_t kind, uint32_t localMs, uint32_t lengthMs);
+  bool refine(const Point& p, uint32_t loggedMs, uint32_t* songMs) const;
+  static void visit(const SongTimeSample& s, void* ctx);
+
+  static const int MAX_BOOTS = 32;
+
+  Timeline* tl_;
+  uint32_t boots_[MAX_BOOTS];   // bootSeq of each boot in the file, oldest first
+  int bootCount_;
+  bool mapped_;
+  Point points_[2 * TIMELINE_MAX_CLIPS];
+  int pointCount_;
+  int clipStartBoot_[TIMELINE_MAX_CLIPS];
+  int clipEndBoot_[TIMELINE_MAX_CLIPS];
+  int curBoot_;
+  bool havePrev_;
+  SongTimeSample prev_;
+  bool stalling_;
+  uint32_t stallFrom_;          // local time the song time stopped advancing
+  SongTimeRefineStats stats_;
+};
+
+// Header-hops an in-memory /songtime.bin through a refiner (host tools).
+void songtime_refine_buffer(Timeline* tl, const uint8_t* data, size_t len,
+                            SongTimeRefineStats* stats);
@@ -0,0 +1,75 @@
+#include "timecode.h"
+#include <stdio.h>
+
+/**
+ * Integer frames-per-second used for timecode labels (30 for 29.97).
+ * @param r Frame rate
+ * @return Rounded frames per second, at least 1
+ */
+uint32_t frame_rate_nominal(const FrameRate& r) {
+  if (r.den == 0) return 1;
+  uint32_t n = (r.num + r.den / 2) / r.den;
+  return n ? n : 1;
+}
+
+/**
+ * Convert song milliseconds to a frame count.
+ * @param ms Time in milliseconds
+ * @param r Frame rate
+ * @return Frame index nearest to ms (frames = ms * num / (den * 1000), rounded)
+ */
+uint64_t ms_to_frames(uint32_t ms, const FrameRate& r) {
+  if (r.den == 0) return 0;
+  uint64_t d = (uint64_t)r.den * 1000;
+  return ((uint64_t)ms * r.num + d / 2) / d;
+}
+
+/**
+ * Format a frame count as SMPTE timecode.
+ * @param frames Frame count from zero
+ * @param r Frame rate; drop-frame rates use ';' before the frame field
+ * @param out Output buffer (at least 12 bytes)
+ * @param cap Size of output buffer
+ * @brief Drop-frame skips frame labels 0 and 1 (0-3 at 59.94) every minute
+ *        except every tenth minute, so the label tracks wall-clock time.
+ */
+void frames_to_timecode(uint64_t frames, const FrameRate& r, char* out, size_t cap) {
+  uint32_t fps = frame_rate_nominal(r);
+
+  if (r.dropFrame && (fps == 30 || fps == 60)) {
+    uint64_t drop = fps / 15;                        // 2 @ 29.97, 4 @ 59.94
+    uint64_t per10 = (uint64_t)fps * 600 - drop * 9; // frames per 10 minutes
+    uint64_t perMin = (uint64_t)fps * 60 - drop;
+    uint64_t d = frames / per10;
+    uint64_t m = frames % per10;
+    frames += drop * 9 * d;
+    if (m > drop) frames += drop * ((m - drop) / perMin);
+  }
+
+  uint64_t ff = frames % fps;
+  uint64_t ss = (frames / fps) % 60;
+  uint64_t mm = (frames / ((uint64_t)fps * 60)) % 60;
+  uint64_t hh = frames / ((uint64_t)fps * 3600);
+
+  snprintf(out, cap, "%02u:%02u:%02u%c%02u",
+           (unsigned)hh, (unsigned)mm, (unsigned)ss,
+           r.dropFrame ? ';' : ':', (unsigned)ff);
+}
+
+/**
+ * Format a frame count as an FCPXML rational time ("<n>/<d>s").
+ * @param frames Frame count
+ * @param r Frame rate
+ * @param out Output buffer
+ * @param cap Size of output buffer
+ * @brief Zero is written as "0s"; whole seconds are reduced to "<n>s".
+ */
+void frames_to_rational(uint64_t frames, const FrameRate& r, char* out, size_t cap) {
+  uint64_t n = frames * r.den;
+  if (n == 0) { snprintf(out, cap, "0s"); return; }
+  if (n % r.num == 0) {
+    snprintf(out, cap, "%llus", (unsigned long long)(n / r.num));
+    return;
+  }
+  snprintf(out, cap, "%llu/%lus", (unsigned long long)n, (unsigned long)r.num);
+}
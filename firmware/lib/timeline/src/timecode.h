@@ -0,0 +1,22 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Exact frame rate as a ratio (e.g. 30000/1001 for 29.97).
+struct FrameRate {
+  uint32_t num;
+  uint32_t den;
+  bool dropFrame;  // only meaningful for 29.97 / 59.94
+};
+
+static const FrameRate FPS_23_976 = { 24000, 1001, false };
+static const FrameRate FPS_25     = { 25, 1, false };
+static const FrameRate FPS_29_97  = { 30000, 1001, false };
+static const FrameRate FPS_29_97_DF = { 30000, 1001, true };
+static const FrameRate FPS_30     = { 30, 1, false };
+static const FrameRate FPS_60     = { 60, 1, false };
+
+uint32_t frame_rate_nominal(const FrameRate& r);
+uint64_t ms_to_frames(uint32_t ms, const FrameRate& r);
+void frames_to_timecode(uint64_t frames, const FrameRate& r, char* out, size_t cap);
+void frames_to_rational(uint64_t frames, const FrameRate& r, char* out, size_t cap);
@@ -0,0 +1,411 @@
+#include "timeline.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+  PARSER
+*/
+/**
+ * Clear a timeline to the "no song, no clips" state.
+ * @param tl Timeline to reset
+ */
+void timeline_reset(Timeline* tl) {
+  memset(tl, 0, sizeof(*tl));
+}
+
+TimelineParser::TimelineParser(Timeline* out)
+    : tl_(out), fill_(0), overflow_(false), curStart_(0), curLast_(0) {
+  line_[0] = '\0';
+  curFile_[0] = '\0';
+  memset(&curStartStamp_, 0, sizeof(curStartStamp_));
+  memset(&curLastStamp_, 0, sizeof(curLastStamp_));
+  timeline_reset(tl_);
+}
+
+/**
+ * Copy a quoted attribute value (key="value") out of a log line.
+ * @param line Log line
+ * @param key Attribute prefix including the opening quote, e.g. "uri=\""
+ * @param dst Destination buffer
+ * @param cap Size of destination buffer
+ * @return true if the key was found
+ */
+static bool extract_quoted(const char* line, const char* key, char* dst, size_t cap) {
+  const char* p = strstr(line, key);
+  if (!p) return false;
+  p += strlen(key);
+  const char* e = strchr(p, '"');
+  size_t n = e ? (size_t)(e - p) : strlen(p);
+  if (n >= cap) n = cap - 1;
+  memcpy(dst, p, n);
+  dst[n] = '\0';
+  return true;
+}
+
+/**
+ * Read a numeric attribute (key=123) from a log line.
+ * @param line Log line
+ * @param key Attribute prefix including '=', e.g. "songMs="
+ * @param out Receives the value if found
+ * @return true if the key was found
+ */
+static bool extract_u32(const char* line, const char* key, uint32_t* out) {
+  const char* p = strstr(line, key);
+  if (!p) return false;
+  *out = (uint32_t)atol(p + strlen(key));
+  return true;
+}
+
+/**
+ * Copy the log stamps of a clip's boundary lines into it.
+ * @param c Clip being closed
+ * @param start Stamp of the opening line
+ * @param end Stamp of the closing line (zeroed if unstamped)
+ */
+static void set_clip_stamps(TimelineClip& c, const EventStamp& start, const EventStamp& end) {
+  c.startSeq = start.seq;
+  c.startT = start.t;
+  c.endSeq = end.seq;
+  c.endT = end.t;
+}
+
+/**
+ * Apply one trimmed log line to the timeline.
+ * @param line Null-terminated line without trailing whitespace
+ * @brief Minimal parser: last SONG wins, CLIP_START/CLIP_END pairs become
+ *        clips (up to TIMELINE_MAX_CLIPS). A CLIP_END without a start is ignored.
+ *        A clip left open by a reset is closed at its last CLIP_AT / CLIP_GAP.
+ *        CLIP_LOST drops the open clip (the camera never started it).
+ */
+void TimelineParser::parse_line(char* line) {
+  while (*line == ' ' || *line == '\t') line++;
+  if (!*line) return;
+
+  if (strncmp(line, "SONG ", 5) == 0) {
+    extract_quoted(line, "uri=\"", tl_->uri, sizeof(tl_->uri));
+    extract_quoted(line, "title=\"", tl_->title, sizeof(tl_->title));
+    extract_u32(line, "durationMs=", &tl_->durationMs);
+  }
+
+  if (strncmp(line, "CLIP_START", 10) == 0) {
+    close_open_clip();
+    extract_quoted(line, "file=\"", curFile_, sizeof(curFile_));
+    extract_u32(line, "songMs=", &curStart_);
+    curLast_ = curStart_;
+    if (!parse_event_stamp(line, &curStartStamp_)) memset(&curStartStamp_, 0, sizeof(curStartStamp_));
+    curLastStamp_ = curStartStamp_;
+  }
+
+  if (curFile_[0] && (strncmp(line, "CLIP_AT ", 8) == 0 || strncmp(line, "CLIP_GAP ", 9) == 0)) {
+    uint32_t t = 0;
+    if (extract_u32(line, "songMs=", &t) || extract_u32(line, "toMs=", &t)) {
+      if (t > curLast_) {
+        curLast_ = t;
+        if (!parse_event_stamp(line, &curLastStamp_)) memset(&curLastStamp_, 0, sizeof(curLastStamp_));
+      }
+    }
+  }
+
+  if (curFile_[0] && strncmp(line, "CLIP_LOST ", 10) == 0) {
+    char file[64] = "";
+    extract_quoted(line, "file=\"", file, sizeof(file));
+    if (strcmp(file, curFile_) == 0) {
+      curFile_[0] = '\0';
+      curStart_ = 0;
+      curLast_ = 0;
+    }
+  }
+
+  if (strncmp(line, "CLIP_END", 8) == 0) {
+    uint32_t endMs = 0;
+    extract_u32(line, "songMs=", &endMs);
+
+    if (tl_->clipCount < TIMELINE_MAX_CLIPS && curFile_[0]) {
+      TimelineClip& c = tl_->clips[tl_->clipCount++];
+      memcpy(c.file, curFile_, sizeof(c.file));
+      c.startMs = curStart_;
+      c.endMs = endMs;
+      EventStamp endStamp;
+      if (!parse_event_stamp(line, &endStamp)) memset(&endStamp, 0, sizeof(endStamp));
+      set_clip_stamps(c, curStartStamp_, endStamp);
+    }
+    curFile_[0] = '\0';
+    curStart_ = 0;
+    curLast_ = 0;
+  }
+}
+
+/**
+ * Turn a clip with no CLIP_END into a clip ending at its last known time.
+ * @brief Dropped if nothing after the start was persisted.
+ */
+void TimelineParser::close_open_clip() {
+  if (!curFile_[0]) return;
+  if (curLast_ > curStart_ && tl_->clipCount < TIMELINE_MAX_CLIPS) {
+    TimelineClip& c = tl_->clips[tl_->clipCount++];
+    memcpy(c.file, curFile_, sizeof(c.file));
+    c.startMs = curStart_;
+    c.endMs = curLast_;
+    set_clip_stamps(c, curStartStamp_, curLastStamp_);
+  }
+  curFile_[0] = '\0';
+  curStart_ = 0;
+  curLast_ = 0;
+}
+
+/**
+ * Feed a block of log text.
+ * @param data Log bytes (need not end on a line boundary)
+ * @param len Number of bytes
+ * @brief line_ holds the longest line the logger writes (EVENT_LOG_LINE_MAX);
+ *        anything longer is corrupt and dropped rather than truncated into
+ *        bogus events.
+ */
+void TimelineParser::feed(const char* data, size_t len) {
+  const char* end = data + len;
+  while (data < end) {
+    const char* nl = (const char*)memchr(data, '\n', end - data);
+    const char* stop = nl ? nl : end;
+    size_t n = stop - data;
+
+    if (!overflow_) {
+      if (fill_ + n < sizeof(line_)) {
+        memcpy(line_ + fill_, data, n);
+        fill_ += n;
+      } else {
+        overflow_ = true;
+      }
+    }
+    data = stop;
+    if (!nl) break;
+    data++;
+
+    if (!overflow_) {
+      while (fill_ > 0 && (line_[fill_ - 1] == '\r' || line_[fill_ - 1] == ' ' ||
+                           line_[fill_ - 1] == '\t')) fill_--;
+      line_[fill_] = '\0';
+      parse_line(line_);
+    }
+    fill_ = 0;
+    overflow_ = false;
+  }
+}
+
+/**
+ * Flush a final line that has no trailing newline.
+ */
+void TimelineParser::finish() {
+  if (fill_ && !overflow_) feed("\n", 1);
+  fill_ = 0;
+  overflow_ = false;
+  close_open_clip();
+}
+
+/**
+ * Read the dev/seq/t trailer appended by the logger.
+ * @param line Log line
+ * @param out Receives the stamp if found
+ * @return false if the line has no complete trailer
+ */
+bool parse_event_stamp(const char* line, EventStamp* out) {
+  const char* p = nullptr;
+  for (const char* q = strstr(line, " dev="); q; q = strstr(q + 1, " dev=")) p = q;
+  if (!p) return false;
+  p += 5;
+
+  size_t n = strcspn(p, " ");
+  if (!n || n >= sizeof(out->dev)) return false;
+  const char* seq = strstr(p + n, " seq=");
+  const char* t = strstr(p + n, " t=");
+  if (!seq || !t) return false;
+
+  memcpy(out->dev, p, n);
+  out->dev[n] = '\0';
+  out->seq = (uint32_t)strtoul(seq + 5, nullptr, 10);
+  out->t = (uint32_t)strtoul(t + 3, nullptr, 10);
+  return true;
+}
+
+/**
+ * Label of a TimelineMark kind, as used in exported markers.
+ * @param kind TimelineMarkKind
+ * @return Static string
+ */
+const char* timeline_mark_name(uint8_t kind) {
+  switch (kind) {
+    case MARK_SEEK: return "seek";
+    case MARK_GAP: return "gap";
+    case MARK_STALL: return "stall";
+  }
+  return "mark";
+}
+
+/*
+  TAIL RECOVERY
+*/
+/**
+ * Apply one log line to the recovered session state.
+ * @param line Null-terminated line without trailing whitespace
+ */
+static void tail_line(const char* line, LogTail* out) {
+  uint32_t t = 0;
+  EventStamp stamp;
+  if (parse_event_stamp(line, &stamp)) {
+    out->stamped = true;
+    out->lastSeq = stamp.seq;
+  }
+  if (strncmp(line, "SONG ", 5) == 0) {
+    out->hasSong = true;
+    extract_quoted(line, "uri=\"", out->uri, sizeof(out->uri));
+    extract_quoted(line, "title=\"", out->title, sizeof(out->title));
+    out->durationMs = 0;
+    extract_u32(line, "durationMs=", &out->durationMs);
+    out->songChanged = out->clipOpen;
+  } else if (strncmp(line, "CLIP_START", 10) == 0) {
+    out->clipOpen = true;
+    extract_quoted(line, "file=\"", out->file, sizeof(out->file));
+    out->startMs = 0;
+    extract_u32(line, "songMs=", &out->startMs);
+    out->lastMs = out->startMs;
+    out->songChanged = false;
+  } else if (strncmp(line, "CLIP_AT ", 8) == 0) {
+    // A checkpoint alone is enough when the CLIP_START fell out of the window
+    char file[64] = "";
+    extract_quoted(line, "file=\"", file, sizeof(file));
+    if (!out->clipOpen || strcmp(file, out->file) != 0) {
+      out->clipOpen = true;
+      memcpy(out->file, file, sizeof(out->file));
+      out->startMs = 0;
+      out->lastMs = 0;
+      out->songChanged = false;
+    }
+    if (extract_u32(line, "songMs=", &t) && t > out->lastMs) out->lastMs = t;
+  } else if (strncmp(line, "CLIP_GAP ", 9) == 0) {
+    if (out->clipOpen && extract_u32(line, "toMs=", &t) && t > out->lastMs) out->lastMs = t;
+  } else if (strncmp(line, "CLIP_END", 8) == 0) {
+    out->clipOpen = false;
+  } else if (strncmp(line, "CLIP_LOST ", 10) == 0) {
+    // The camera never started it: nothing to resume or close
+    char file[64] = "";
+    extract_quoted(line, "file=\"", file, sizeof(file));
+    if (strcmp(file, out->file) == 0) out->clipOpen = false;
+  }
+}
+
+/**
+ * Recover the session state from a window at the end of the log.
+ * @param data Last bytes of events.log
+ * @param len Number of bytes
+ * @param fromStart true if data starts at offset 0 of the file
+ * @param out Receives the state (reset first)
+ * @brief Cost depends only on len, so callers bound it to keep boot flat.
+ */
+void log_tail_scan(const char* data, size_t len, bool fromStart, LogTail* out) {
+  memset(out, 0, sizeof(*out));
+  const char* end = data + len;
+  if (!fromStart) {
+    const char* nl = (const char*)memchr(data, '\n', len);
+    data = nl ? nl + 1 : end;
+  }
+
+  char line[EVENT_LOG_LINE_MAX];
+  while (data < end) {
+    const char* nl = (const char*)memchr(data, '\n', end - data);
+    if (!nl) {
+      out->torn = true;  // interrupted append
+      break;
+    }
+    size_t n = nl - data;
+    while (n && (data[n - 1] == '\r' || data[n - 1] == ' ' || data[n - 1] == '\t')) n--;
+    if (n < sizeof(line)) {
+      memcpy(line, data, n);
+      line[n] = '\0';
+      tail_line(line, out);
+    }
+    data = nl + 1;
+  }
+}
+
+/*
+  SINK HELPERS
+*/
+void TimelineSink::put(const char* s) {
+  write(s, strlen(s));
+}
+
+void TimelineSink::put_u32(uint32_t v) {
+  char buf[12];
+  int n = snprintf(buf, sizeof(buf), "%lu", (unsigned long)v);
+  write(buf, n);
+}
+
+/**
+ * Write text with XML attribute escaping (&, <, >, ").
+ * @param s Null-terminated text
+ */
+void TimelineSink::put_xml(const char* s) {
+  const char* run = s;
+  for (; *s; s++) {
+    const char* esc = nullptr;
+    switch (*s) {
+      case '&': esc = "&amp;"; break;
+      case '<': esc = "&lt;"; break;
+      case '>': esc = "&gt;"; break;
+      case '"': esc = "&quot;"; break;
+      default: continue;
+    }
+    write(run, s - run);
+    put(esc);
+    run = s + 1;
+  }
+  write(run, s - run);
+}
+
+/**
+ * Write text with JSON string escaping (quotes, backslash, control chars).
+ * @param s Null-terminated text
+ */
+void TimelineSink::put_json(const char* s) {
+  const char* run = s;
+  for (; *s; s++) {
+    unsigned char c = (unsigned char)*s;
+    if (c != '"' && c != '\\' && c >= 0x20) continue;
+    write(run, s - run);
+    char esc[8];
+    if (c == '"' || c == '\\') snprintf(esc, sizeof(esc), "\\%c", c);
+    else snprintf(esc, sizeof(esc), "\\u%04x", c);
+    put(esc);
+    run = s + 1;
+  }
+  write(run, s - run);
+}
+
+/*
+  SINGLE-PASS EMIT
+*/
+/**
+ * Drive every writer through begin / clips / end in one walk of the timeline.
+ * @param tl Parsed timeline
+ * @param writers Writers to run
+ * @param sinks Output sink for each writer (same index)
+ * @param count Number of writers
+ * @param elapsedUs Optional per-writer accumulated time (same index)
+ * @param nowUs Optional microsecond clock used for elapsedUs
+ */
+void timeline_emit(const Timeline& tl, TimelineWriter* const* writers,
+                   TimelineSink* const* sinks, int count,
+                   uint32_t* elapsedUs, uint32_t (*nowUs)()) {
+  bool timed = elapsedUs && nowUs;
+  if (timed) for (int w = 0; w < count; w++) elapsedUs[w] = 0;
+
+  for (int step = -1; step <= tl.clipCount; step++) {
+    for (int w = 0; w < count; w++) {
+      uint32_t t0 = timed ? nowUs() : 0;
+      if (step < 0) writers[w]->begin(*sinks[w], tl);
+      else if (step < tl.clipCount) writers[w]->clip(*sinks[w], tl, step);
+      else writers[w]->end(*sinks[w], tl);
+      if (timed) elapsedUs[w] += nowUs() - t0;
+    }
+  }
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "event_format.h"
+#include "timecode.h"
+
+/*
+  Timeline model built from one pass over events.log, shared by every
+  export format. Kept free of Arduino types so it also builds on a host.
+*/
+static const int TIMELINE_MAX_CLIPS = 32;
+static const int TIMELINE_MAX_MARKS = 64;
+
+struct TimelineClip {
+  char file[64];
+  uint32_t startMs;
+  uint32_t endMs;
+  uint32_t startSeq, startT;  // stamp of the line that opened it (0 = unstamped)
+  uint32_t endSeq, endT;      // stamp of the line that closed it
+};
+
+enum TimelineMarkKind : uint8_t {
+  MARK_SEEK,    // song time jumped
+  MARK_GAP,     // no song-time update from the phone
+  MARK_STALL,   // updates kept coming but song time stood still
+};
+
+/**
+ * Discontinuity inside a clip, found by SongTimeRefiner (songtime_trace.h).
+ */
+struct TimelineMark {
+  uint8_t clip;
+  uint8_t kind;         // TimelineMarkKind
+  uint32_t offsetMs;    // from the start of the clip
+  uint32_t lengthMs;
+};
+
+struct Timeline {
+  char uri[192];
+  char title[96];
+  uint32_t durationMs;
+  TimelineClip clips[TIMELINE_MAX_CLIPS];
+  int clipCount;
+  TimelineMark marks[TIMELINE_MAX_MARKS];
+  int markCount;
+};
+
+/**
+ * Session state recovered from the end of events.log after a reset.
+ */
+struct LogTail {
+  bool hasSong;
+  char uri[192];
+  char title[96];
+  uint32_t durationMs;
+  bool clipOpen;        // CLIP_START (or CLIP_AT) with no CLIP_END / CLIP_LOST after it
+  char file[64];
+  uint32_t startMs;
+  uint32_t lastMs;      // last persisted song time of the open clip
+  bool songChanged;     // a SONG line followed the open clip's start
+  bool torn;            // log ends in a partial line
+  bool stamped;         // at least one line carried a dev/seq/t trailer
+  uint32_t lastSeq;     // sequence number of the last stamped line
+};
+
+/**
+ * Per-line trailer written by the logger (see format_event_stamp()).
+ */
+struct EventStamp {
+  char dev[16];
+  uint32_t seq;
+  uint32_t t;           // ms since that device booted
+};
+
+/**
+ * Incremental events.log parser.
+ * @brief Accepts the log in arbitrary blocks (e.g. straight from LittleFS)
+ *        and splits it into lines internally.
+ */
+class TimelineParser {
+ public:
+  explicit TimelineParser(Timeline* out);
+
+  void feed(const char* data, size_t len);
+  void finish();
+
+ private:
+  void parse_line(char* line);
+  void close_open_clip();
+
+  Timeline* tl_;
+  char line_[EVENT_LOG_LINE_MAX];
+  size_t fill_;
+  bool overflow_;
+  char curFile_[64];
+  uint32_t curStart_;
+  uint32_t curLast_;    // latest song time seen for the open clip
+  EventStamp curStartStamp_;
+  EventStamp curLastStamp_;
+};
+
+/**
+ * Byte sink a writer emits into (buffered file, UART, memory...).
+ */
+class TimelineSink {
+ public:
+  virtual ~TimelineSink() {}
+  virtual void write(const char* data, size_t len) = 0;
+
+  void put(const char* s);
+  void put_u32(uint32_t v);
+  void put_xml(const char* s);   // escaped attribute text
+  void put_json(const char* s);  // escaped string body (no quotes)
+};
+
+/**
+ * One export format. Called begin, clip x N, end against a parsed timeline.
+ */
+class TimelineWriter {
+ public:
+  virtual ~TimelineWriter() {}
+  virtual const char* name() const = 0;
+  virtual void begin(TimelineSink& out, const Timeline& tl) = 0;
+  virtual void clip(TimelineSink& out, const Timeline& tl, int index) = 0;
+  virtual void end(TimelineSink& out, const Timeline& tl) = 0;
+};
+
+void timeline_reset(Timeline* tl);
+
+// Scans the last bytes of events.log for the song and any clip a reset left
+// open. If fromStart is false, data begins mid-line and the first partial
+// line is skipped. Only newline-terminated lines are used.
+void log_tail_scan(const char* data, size_t len, bool fromStart, LogTail* out);
+
+// Reads the " dev=ID seq=N t=MS" trailer of a log line. The last " dev=" on
+// the line is used, so quoted titles can't spoof it. false if the line has
+// no trailer (logs written before stamping).
+bool parse_event_stamp(const char* line, EventStamp* out);
+
+// "seek", "gap" or "stall".
+const char* timeline_mark_name(uint8_t kind);
+
+// Drives all writers through the timeline in one pass. If elapsedUs is
+// non-null and nowUs is set, per-writer time is accumulated into it.
+void timeline_emit(const Timeline& tl, TimelineWriter* const* writers,
+                   TimelineSink* const* sinks, int count,
+                   uint32_t* elapsedUs, uint32_t (*nowUs)());
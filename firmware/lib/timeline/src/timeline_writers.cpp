@@ -0,0 +1,267 @@
+#include "timeline_writers.h"
+#include <stdio.h>
+
+/*
+  LEGACY XML
+  Same bytes the original f.print/f.println exporter produced (CRLF lines,
+  attribute values unescaped) so existing phone/post tooling keeps working.
+*/
+void LegacyXmlWriter::begin(TimelineSink& out, const Timeline& tl) {
+  out.put("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\r\n");
+  out.put("<Project name=\"Session1\">\r\n");
+  out.put("  <Song uri=\""); out.put(tl.uri);
+  out.put("\" title=\""); out.put(tl.title);
+  out.put("\" durationMs=\""); out.put_u32(tl.durationMs);
+  out.put("\"/>\r\n");
+}
+
+void LegacyXmlWriter::clip(TimelineSink& out, const Timeline& tl, int index) {
+  const TimelineClip& c = tl.clips[index];
+  out.put("  <Clip file=\""); out.put(c.file);
+  out.put("\" startSongMs=\""); out.put_u32(c.startMs);
+  out.put("\" endSongMs=\""); out.put_u32(c.endMs);
+  out.put("\"/>\r\n");
+}
+
+void LegacyXmlWriter::end(TimelineSink& out, const Timeline& tl) {
+  (void)tl;
+  out.put("</Project>\r\n");
+}
+
+/*
+  FCPXML
+*/
+/**
+ * Length of the song timeline in frames: song duration, or the last clip
+ * end if a clip runs past it. Never less than one frame.
+ */
+static uint64_t sequence_frames(const Timeline& tl, const FrameRate& r) {
+  uint32_t endMs = tl.durationMs;
+  for (int i = 0; i < tl.clipCount; i++)
+    if (tl.clips[i].endMs > endMs) endMs = tl.clips[i].endMs;
+  uint64_t n = ms_to_frames(endMs, r);
+  return n ? n : 1;
+}
+
+/**
+ * Clip length in whole frames (start/end are snapped independently so
+ * adjacent clips never overlap or leave a sub-frame hole).
+ */
+static uint64_t clip_frames(const TimelineClip& c, const FrameRate& r) {
+  uint64_t a = ms_to_frames(c.startMs, r);
+  uint64_t b = ms_to_frames(c.endMs, r);
+  return b > a ? b - a : 0;
+}
+
+/**
+ * Whether SongTimeRefiner flagged anything inside a clip.
+ */
+static bool clip_has_marks(const Timeline& tl, int index) {
+  for (int i = 0; i < tl.markCount; i++)
+    if (tl.marks[i].clip == index) return true;
+  return false;
+}
+
+/**
+ * Marker length in frames, at least one so editors show it.
+ */
+static uint64_t mark_frames(const TimelineMark& m, const FrameRate& r) {
+  uint64_t n = ms_to_frames(m.lengthMs, r);
+  return n ? n : 1;
+}
+
+void FcpxmlWriter::put_time(TimelineSink& out, uint64_t frames) {
+  char buf[40];
+  frames_to_rational(frames, rate_, buf, sizeof(buf));
+  out.put(buf);
+}
+
+void FcpxmlWriter::begin(TimelineSink& out, const Timeline& tl) {
+  out.put("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+  out.put("<!DOCTYPE fcpxml>\n\n");
+  out.put("<fcpxml version=\"1.8\">\n");
+  out.put("  <resources>\n");
+  out.put("    <format id=\"r0\" frameDuration=\""); put_time(out, 1);
+  out.put("\" width=\"1920\" height=\"1080\"/>\n");
+
+  for (int i = 0; i < tl.clipCount; i++) {
+    const TimelineClip& c = tl.clips[i];
+    out.put("    <asset id=\"r"); out.put_u32(i + 1);
+    out.put("\" name=\""); out.put_xml(c.file);
+    out.put("\" src=\"file:./"); out.put_xml(c.file);
+    out.put("\" start=\"0s\" duration=\""); put_time(out, clip_frames(c, rate_));
+    out.put("\" hasVideo=\"1\" hasAudio=\"1\" format=\"r0\"/>\n");
+  }
+
+  uint64_t total = sequence_frames(tl, rate_);
+  out.put("  </resources>\n");
+  out.put("  <library>\n");
+  out.put("    <event name=\"MusicSync\">\n");
+  out.put("      <project name=\"Session1\">\n");
+  out.put("        <sequence format=\"r0\" duration=\""); put_time(out, total);
+  out.put(rate_.dropFrame ? "\" tcStart=\"0s\" tcFormat=\"DF\">\n"
+                          : "\" tcStart=\"0s\" tcFormat=\"NDF\">\n");
+  out.put("          <spine>\n");
+  out.put("            <gap name=\""); out.put_xml(tl.title[0] ? tl.title : "Song");
+  out.put("\" offset=\"0s\" start=\"0s\" duration=\""); put_time(out, total);
+  out.put("\">\n");
+  if (tl.uri[0]) {
+    out.put("              <note>"); out.put_xml(tl.uri); out.put("</note>\n");
+  }
+}
+
+void FcpxmlWriter::clip(TimelineSink& out, const Timeline& tl, int index) {
+  const TimelineClip& c = tl.clips[index];
+  out.put("              <asset-clip ref=\"r"); out.put_u32(index + 1);
+  out.put("\" lane=\"1\" offset=\""); put_time(out, ms_to_frames(c.startMs, rate_));
+  out.put("\" name=\""); out.put_xml(c.file);
+  out.put("\" start=\"0s\" duration=\""); put_time(out, clip_frames(c, rate_));
+  if (!clip_has_marks(tl, index)) {
+    out.put("\"/>\n");
+    return;
+  }
+
+  out.put("\">\n");
+  for (int i = 0; i < tl.markCount; i++) {
+    const TimelineMark& m = tl.marks[i];
+    if (m.clip != index) continue;
+    out.put("                <marker start=\""); put_time(out, ms_to_frames(m.offsetMs, rate_));
+    out.put("\" duration=\""); put_time(out, mark_frames(m, rate_));
+    out.put("\" value=\""); out.put(timeline_mark_name(m.kind));
+    out.put("\"/>\n");
+  }
+  out.put("              </asset-clip>\n");
+}
+
+void FcpxmlWriter::end(TimelineSink& out, const Timeline& tl) {
+  (void)tl;
+  out.put("            </gap>\n");
+  out.put("          </spine>\n");
+  out.put("        </sequence>\n");
+  out.put("      </project>\n");
+  out.put("    </event>\n");
+  out.put("  </library>\n");
+  out.put("</fcpxml>\n");
+}
+
+/*
+  CMX3600 EDL
+*/
+void Cmx3600EdlWriter::begin(TimelineSink& out, const Timeline& tl) {
+  (void)tl;
+  out.put("TITLE: Session1\n");
+  out.put(rate_.dropFrame ? "FCM: DROP FRAME\n\n" : "FCM: NON-DROP FRAME\n\n");
+}
+
+void Cmx3600EdlWriter::clip(TimelineSink& out, const Timeline& tl, int index) {
+  const TimelineClip& c = tl.clips[index];
+  uint64_t recIn = ms_to_frames(c.startMs, rate_);
+  uint64_t dur = clip_frames(c, rate_);
+
+  char srcIn[16], srcOut[16], rIn[16], rOut[16];
+  frames_to_timecode(0, rate_, srcIn, sizeof(srcIn));
+  frames_to_timecode(dur, rate_, srcOut, sizeof(srcOut));
+  frames_to_timecode(recIn, rate_, rIn, sizeof(rIn));
+  frames_to_timecode(recIn + dur, rate_, rOut, sizeof(rOut));
+
+  char line[128];
+  snprintf(line, sizeof(line), "%03d  AX       V     C        %s %s %s %s\n",
+           index + 1, srcIn, srcOut, rIn, rOut);
+  out.put(line);
+  out.put("* FROM CLIP NAME: "); out.put(c.file); out.put("\n\n");
+}
+
+void Cmx3600EdlWriter::end(TimelineSink& out, const Timeline& tl) {
+  (void)out; (void)tl;
+}
+
+/*
+  OPENTIMELINEIO JSON
+*/
+void OtioJsonWriter::put_rational(TimelineSink& out, uint64_t frames) {
+  char buf[96];
+  snprintf(buf, sizeof(buf),
+           "{\"OTIO_SCHEMA\": \"RationalTime.1\", \"rate\": %.10g, \"value\": %llu}",
+           (double)rate_.num / rate_.den, (unsigned long long)frames);
+  out.put(buf);
+}
+
+void OtioJsonWriter::put_range(TimelineSink& out, uint64_t start, uint64_t dur) {
+  out.put("{\"OTIO_SCHEMA\": \"TimeRange.1\", \"start_time\": ");
+  put_rational(out, start);
+  out.put(", \"duration\": ");
+  put_rational(out, dur);
+  out.put("}");
+}
+
+void OtioJsonWriter::begin(TimelineSink& out, const Timeline& tl) {
+  cursor_ = 0;
+  first_ = true;
+  out.put("{\n");
+  out.put("  \"OTIO_SCHEMA\": \"Timeline.1\",\n");
+  out.put("  \"name\": \"Session1\",\n");
+  out.put("  \"global_start_time\": null,\n");
+  out.put("  \"metadata\": {\"musicsync\": {\"uri\": \""); out.put_json(tl.uri);
+  out.put("\", \"title\": \""); out.put_json(tl.title);
+  out.put("\", \"durationMs\": "); out.put_u32(tl.durationMs);
+  out.put("}},\n");
+  out.put("  \"tracks\": {\n");
+  out.put("    \"OTIO_SCHEMA\": \"Stack.1\",\n");
+  out.put("    \"name\": \"tracks\",\n");
+  out.put("    \"metadata\": {},\n");
+  out.put("    \"children\": [\n");
+  out.put("      {\n");
+  out.put("        \"OTIO_SCHEMA\": \"Track.1\",\n");
+  out.put("        \"name\": \"Video\",\n");
+  out.put("        \"kind\": \"Video\",\n");
+  out.put("        \"metadata\": {},\n");
+  out.put("        \"children\": [");
+}
+
+void OtioJsonWriter::clip(TimelineSink& out, const Timeline& tl, int index) {
+  const TimelineClip& c = tl.clips[index];
+  uint64_t start = ms_to_frames(c.startMs, rate_);
+  uint64_t dur = clip_frames(c, rate_);
+
+  if (start > cursor_) {
+    out.put(first_ ? "\n" : ",\n");
+    first_ = false;
+    out.put("          {\"OTIO_SCHEMA\": \"Gap.1\", \"name\": \"\", \"source_range\": ");
+    put_range(out, 0, start - cursor_);
+    out.put("}");
+    cursor_ = start;
+  }
+
+  out.put(first_ ? "\n" : ",\n");
+  first_ = false;
+  out.put("          {\"OTIO_SCHEMA\": \"Clip.1\", \"name\": \""); out.put_json(c.file);
+  out.put("\", \"source_range\": ");
+  put_range(out, 0, dur);
+  out.put(", \"media_reference\": {\"OTIO_SCHEMA\": \"ExternalReference.1\", \"target_url\": \"");
+  out.put_json(c.file);
+  out.put("\", \"available_range\": null, \"metadata\": {}}");
+  out.put(", \"metadata\": {\"musicsync\": {\"startSongMs\": "); out.put_u32(c.startMs);
+  out.put(", \"endSongMs\": "); out.put_u32(c.endMs);
+  out.put("}}, \"effects\": [], \"markers\": [");
+  bool firstMark = true;
+  for (int i = 0; i < tl.markCount; i++) {
+    const TimelineMark& m = tl.marks[i];
+    if (m.clip != index) continue;
+    out.put(firstMark ? "" : ", ");
+    firstMark = false;
+    out.put("{\"OTIO_SCHEMA\": \"Marker.1\", \"name\": \""); out.put(timeline_mark_name(m.kind));
+    out.put("\", \"color\": \"RED\", \"marked_range\": ");
+    put_range(out, ms_to_frames(m.offsetMs, rate_), mark_frames(m, rate_));
+    out.put(", \"metadata\": {}}");
+  }
+  out.put("]}");
+  cursor_ += dur;
+}
+
+void OtioJsonWriter::end(TimelineSink& out, const Timeline& tl) {
+  out.put(tl.clipCount ? "\n        ]\n" : "]\n");
+  out.put("      }\n");
+  out.put("    ]\n");
+  out.put("  }\n");
+  out.put("}\n");
+}
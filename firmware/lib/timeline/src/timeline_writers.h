@@ -0,0 +1,64 @@
+#pragma once
+#include "timeline.h"
+
+/**
+ * Original /project.xml schema (<Project>/<Song>/<Clip>), byte-for-byte.
+ */
+class LegacyXmlWriter : public TimelineWriter {
+ public:
+  const char* name() const override { return "xml"; }
+  void begin(TimelineSink& out, const Timeline& tl) override;
+  void clip(TimelineSink& out, const Timeline& tl, int index) override;
+  void end(TimelineSink& out, const Timeline& tl) override;
+};
+
+/**
+ * Final Cut Pro X FCPXML 1.8: one asset per clip, connected on lane 1 above
+ * a gap spanning the song.
+ */
+class FcpxmlWriter : public TimelineWriter {
+ public:
+  explicit FcpxmlWriter(const FrameRate& rate) : rate_(rate) {}
+  const char* name() const override { return "fcpxml"; }
+  void begin(TimelineSink& out, const Timeline& tl) override;
+  void clip(TimelineSink& out, const Timeline& tl, int index) override;
+  void end(TimelineSink& out, const Timeline& tl) override;
+
+ private:
+  void put_time(TimelineSink& out, uint64_t frames);
+  FrameRate rate_;
+};
+
+/**
+ * CMX3600 EDL: one video event per clip, record times on the song timeline.
+ */
+class Cmx3600EdlWriter : public TimelineWriter {
+ public:
+  explicit Cmx3600EdlWriter(const FrameRate& rate) : rate_(rate) {}
+  const char* name() const override { return "edl"; }
+  void begin(TimelineSink& out, const Timeline& tl) override;
+  void clip(TimelineSink& out, const Timeline& tl, int index) override;
+  void end(TimelineSink& out, const Timeline& tl) override;
+
+ private:
+  FrameRate rate_;
+};
+
+/**
+ * OpenTimelineIO JSON (Timeline.1): a single video track of gaps and clips.
+ */
+class OtioJsonWriter : public TimelineWriter {
+ public:
+  explicit OtioJsonWriter(const FrameRate& rate) : rate_(rate), cursor_(0), first_(true) {}
+  const char* name() const override { return "otio"; }
+  void begin(TimelineSink& out, const Timeline& tl) override;
+  void clip(TimelineSink& out, const Timeline& tl, int index) override;
+  void end(TimelineSink& out, const Timeline& tl) override;
+
+ private:
+  void put_rational(TimelineSink& out, uint64_t frames);
+  void put_range(TimelineSink& out, uint64_t start, uint64_t dur);
+  FrameRate rate_;
+  uint64_t cursor_;
+  bool first_;
+};
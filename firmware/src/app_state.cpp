@@ -1,4 +1,3 @@
 #include "app_state.h"
 
-uint32_t g_songTimeMs = 0;
-SongMeta g_song = { "", "", 0 };
\ No newline at end of file
+SyncEngine g_sync;
\ No newline at end of file
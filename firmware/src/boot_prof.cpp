@@ -0,0 +1,72 @@
+#include "boot_prof.h"
+#include <esp_timer.h>
+
+static BootPhase g_phases[BOOT_MAX_PHASES];
+static volatile int g_phase_count = 0;
+static uint32_t g_adv_us = 0;
+
+static uint32_t now_us() {
+  return (uint32_t)esp_timer_get_time();
+}
+
+/**
+ * Start timing a boot phase.
+ * @param name Static phase name (not copied)
+ * @return Phase id for boot_phase_end(), or -1 if the table is full
+ */
+int boot_phase_begin(const char* name) {
+  int id = g_phase_count;
+  if (id >= BOOT_MAX_PHASES) return -1;
+  g_phases[id].name = name;
+  g_phases[id].startUs = now_us();
+  g_phases[id].endUs = 0;
+  g_phase_count = id + 1;
+  return id;
+}
+
+/**
+ * Finish a boot phase (ignored if already finished or id is invalid).
+ * @param id Value returned by boot_phase_begin()
+ */
+void boot_phase_end(int id) {
+  if (id < 0 || id >= g_phase_count || g_phases[id].endUs) return;
+  g_phases[id].endUs = now_us();
+}
+
+/**
+ * Record the moment BLE advertising started (time-to-advertise metric).
+ */
+void boot_mark_advertising() {
+  if (!g_adv_us) g_adv_us = now_us();
+}
+
+int boot_phase_count() {
+  return g_phase_count;
+}
+
+const BootPhase& boot_phase(int id) {
+  return g_phases[id];
+}
+
+uint32_t boot_advertise_us() {
+  return g_adv_us;
+}
+
+/**
+ * Print the boot timeline.
+ * @param out Destination (Serial)
+ * @brief One line per phase: start offset and duration in ms; phases still
+ *        running are shown as "running".
+ */
+void boot_report(Print& out) {
+  out.printf("[BOOT] time-to-advertise %.1f ms\n", g_adv_us / 1000.0f);
+  for (int i = 0; i < g_phase_count; i++) {
+    const BootPhase& p = g_phases[i];
+    if (p.endUs) {
+      out.printf("[BOOT] %-8s @%8.1f ms  %8.1f ms\n", p.name,
+                 p.startUs / 1000.0f, (p.endUs - p.startUs) / 1000.0f);
+    } else {
+      out.printf("[BOOT] %-8s @%8.1f ms  running\n", p.name, p.startUs / 1000.0f);
+    }
+  }
+}
@@ -0,0 +1,60 @@
+#include "console.h"
+#include <esp_log.h>
+#include <stdarg.h>
+
+static SemaphoreHandle_t g_console_lock = nullptr;
+static bool g_console_quiet = false;
+
+/**
+ * Create the console lock.
+ * @brief Lines printed before this (single-threaded boot) go out unlocked.
+ */
+void console_begin() {
+  if (!g_console_lock) g_console_lock = xSemaphoreCreateMutex();
+}
+
+/**
+ * Mute or unmute console output from other tasks.
+ * @param quiet true while something else owns the UART
+ * @brief Takes the lock, so a line already being printed finishes first.
+ *        ESP-IDF component logs (Wi-Fi driver) share the UART and are
+ *        muted as well, then set back to the build's default level.
+ */
+void console_quiet(bool quiet) {
+  if (g_console_lock) xSemaphoreTake(g_console_lock, portMAX_DELAY);
+  g_console_quiet = quiet;
+  esp_log_level_set("*", quiet ? ESP_LOG_NONE : (esp_log_level_t)CONFIG_LOG_DEFAULT_LEVEL);
+  if (g_console_lock) xSemaphoreGive(g_console_lock);
+}
+
+/**
+ * Write one line unless the console is muted.
+ */
+static void console_write(const char* text, size_t len, bool newline) {
+  if (g_console_lock) xSemaphoreTake(g_console_lock, portMAX_DELAY);
+  if (!g_console_quiet) {
+    Serial.write((const uint8_t*)text, len);
+    if (newline) Serial.write((const uint8_t*)"\r\n", 2);
+  }
+  if (g_console_lock) xSemaphoreGive(g_console_lock);
+}
+
+/**
+ * printf to the console (dropped while muted).
+ */
+void console_printf(const char* fmt, ...) {
+  char buf[320];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+  if (n < 0) return;
+  console_write(buf, min((size_t)n, sizeof(buf) - 1), false);
+}
+
+/**
+ * println to the console (dropped while muted).
+ */
+void console_println(const char* line) {
+  console_write(line, strlen(line), true);
+}
@@ -1,8 +1,13 @@
 #include "event_log.h"
 #include <LittleFS.h>
 
+#include "event_format.h"
+
 static const char* EVENTS_PATH = "/events.log";
 
+static char g_device_id[16] = "esp32";
+static uint32_t g_event_seq = 0;  // last sequence number written
+
 /**
  * Initialize LittleFS filesystem for event logging.
  * @return true if filesystem mounted successfully, false otherwise
@@ -13,16 +18,36 @@ bool event_log_begin() {
   return LittleFS.begin(true);
 }
 
+/**
+ * Set the device ID stamped on every log line.
+ * @param id Short ID without spaces (truncated to 15 characters)
+ */
+void event_log_set_device(const char* id) {
+  strncpy(g_device_id, id, sizeof(g_device_id) - 1);
+  g_device_id[sizeof(g_device_id) - 1] = '\0';
+}
+
+const char* event_log_device() {
+  return g_device_id;
+}
+
+uint32_t event_log_seq() {
+  return g_event_seq;
+}
+
 /**
  * Append a line to the events.log file.
  * @param line Text line to append (newline will be added automatically)
- * @brief Opens file in append mode, writes line, closes file.
- *        Fails silently if file cannot be opened.
+ * @brief Opens file in append mode, writes line plus the dev/seq/t stamp,
+ *        closes file. Fails silently if file cannot be opened.
  */
-static void append_line(const String& line) {
+static void append_line(const char* line) {
   File f = LittleFS.open(EVENTS_PATH, "a");
   if (!f) return;
-  f.println(line);
+  char stamp[EVENT_STAMP_MAX];
+  format_event_stamp(stamp, sizeof(stamp), g_device_id, ++g_event_seq, millis());
+  f.print(line);
+  f.println(stamp);
   f.close();
 }
 
@@ -33,8 +58,10 @@ static void append_line(const String& line) {
  * @param durationMs Song duration in milliseconds
  * @brief Writes SONG event with URI, title, and duration for timeline export.
  */
-void log_song(const String& uri, const String& title, uint32_t durationMs) {
-  append_line("SONG uri=\"" + uri + "\" title=\"" + title + "\" durationMs=" + String(durationMs));
+void log_song(const char* uri, const char* title, uint32_t durationMs) {
+  char line[EVENT_LINE_MAX];
+  format_song_line(line, sizeof(line), uri, title, durationMs);
+  append_line(line);
 }
 
 /**
@@ -43,8 +70,10 @@ void log_song(const String& uri, const String& title, uint32_t durationMs) {
  * @param songMs Song playback time in milliseconds when recording started
  * @brief Writes CLIP_START event for synchronizing video with audio timeline.
  */
-void log_clip_start(const String& filename, uint32_t songMs) {
-  append_line("CLIP_START file=\"" + filename + "\" songMs=" + String(songMs));
+void log_clip_start(const char* filename, uint32_t songMs) {
+  char line[128];
+  format_clip_start_line(line, sizeof(line), filename, songMs);
+  append_line(line);
 }
 
 /**
@@ -53,8 +82,61 @@ void log_clip_start(const String& filename, uint32_t songMs) {
  * @param songMs Song playback time in milliseconds when recording stopped
  * @brief Writes CLIP_END event for synchronizing video with audio timeline.
  */
-void log_clip_end(const String& filename, uint32_t songMs) {
-  append_line("CLIP_END file=\"" + filename + "\" songMs=" + String(songMs));
+void log_clip_end(const char* filename, uint32_t songMs) {
+  char line[128];
+  format_clip_end_line(line, sizeof(line), filename, songMs);
+  append_line(line);
+}
+
+/**
+ * Log a pause that was bridged inside one clip.
+ * @param filename Video filename of the clip that kept recording
+ * @param fromMs Song time when playback paused
+ * @param toMs Song time when playback resumed
+ * @param pauseMs Wall-clock length of the pause
+ * @brief Writes a CLIP_GAP marker; the clip itself stays open.
+ */
+void log_clip_gap(const char* filename, uint32_t fromMs, uint32_t toMs, uint32_t pauseMs) {
+  char line[160];
+  format_clip_gap_line(line, sizeof(line), filename, fromMs, toMs, pauseMs);
+  append_line(line);
+}
+
+/**
+ * Log a song-time checkpoint for the open clip.
+ * @param filename Video filename of the clip being recorded
+ * @param songMs Current song time in milliseconds
+ * @brief Writes CLIP_AT; boot recovery closes a clip at its last checkpoint.
+ */
+void log_clip_at(const char* filename, uint32_t songMs) {
+  char line[128];
+  format_clip_at_line(line, sizeof(line), filename, songMs);
+  append_line(line);
+}
+
+/**
+ * Log the end of a clip that a reset left open.
+ * @param filename Video filename of the recovered clip
+ * @param songMs Last persisted song time of the clip
+ * @brief Writes CLIP_END with recovered=1 so tools can tell it was inferred.
+ */
+void log_clip_recovered(const char* filename, uint32_t songMs) {
+  char line[144];
+  format_clip_recovered_line(line, sizeof(line), filename, songMs);
+  append_line(line);
+}
+
+/**
+ * Log that the camera never started the open clip.
+ * @param filename Video filename of the clip
+ * @param songMs Song time its CLIP_START was logged at
+ * @brief Writes CLIP_LOST; exporters drop the clip instead of pointing at
+ *        footage that doesn't exist.
+ */
+void log_clip_lost(const char* filename, uint32_t songMs) {
+  char line[128];
+  format_clip_lost_line(line, sizeof(line), filename, songMs);
+  append_line(line);
 }
 
 /**
@@ -62,19 +144,120 @@ void log_clip_end(const String& filename, uint32_t songMs) {
  * @brief Deletes /events.log to start a fresh recording session.
  */
 void clear_events() {
-  LittleFS.remove("/events.log");
+  LittleFS.remove(EVENTS_PATH);
+}
+
+/**
+ * Get the size of a file on LittleFS.
+ * @param path Absolute file path
+ * @return File size in bytes, or 0 if the file doesn't exist
+ */
+size_t file_size(const char* path) {
+  File f = LittleFS.open(path, "r");
+  if (!f) return 0;
+  size_t n = f.size();
+  f.close();
+  return n;
+}
+
+/**
+ * Get the current size of events.log.
+ * @return Size in bytes, or 0 if the log doesn't exist
+ */
+size_t events_size() {
+  return file_size(EVENTS_PATH);
 }
 
 /**
- * Read entire events.log file contents.
- * @return Complete contents of events.log, or empty string if file doesn't exist
- * @brief Reads all logged events for processing/export to XML.
+ * Stream a byte range of a file to a sink using block reads.
+ * @param path Absolute file path
+ * @param offset First byte to read
+ * @param len Maximum number of bytes to read (clamped to end of file)
+ * @param sink Callback receiving each block (never more than FS_READ_BLOCK bytes)
+ * @param ctx Opaque pointer passed through to sink
+ * @return Continuation offset: where the next ranged read should start
+ * @brief Reads straight from LittleFS in FS_READ_BLOCK pieces so the file is
+ *        never materialized in RAM. Offsets past EOF deliver nothing.
  */
-String read_events() {
-  File f = LittleFS.open(EVENTS_PATH, "r");
-  if (!f) return "";
-  String out;
-  while (f.available()) out += char(f.read());
+size_t read_file_range(const char* path, size_t offset, size_t len,
+                       ChunkSink sink, void* ctx) {
+  File f = LittleFS.open(path, "r");
+  if (!f) return offset;
+
+  size_t size = f.size();
+  if (offset >= size) { f.close(); return offset; }
+  if (len > size - offset) len = size - offset;
+  if (!f.seek(offset)) { f.close(); return offset; }
+
+  uint8_t buf[FS_READ_BLOCK];
+  size_t done = 0;
+  while (done < len) {
+    size_t want = min(sizeof(buf), len - done);
+    size_t got = f.read(buf, want);
+    if (got == 0) break;
+    if (sink) sink(buf, got, ctx);
+    done += got;
+  }
+
   f.close();
-  return out;
+  return offset + done;
+}
+
+/**
+ * Stream a byte range of events.log to a sink.
+ * @param offset First byte to read
+ * @param len Maximum number of bytes to read
+ * @param sink Callback receiving each block
+ * @param ctx Opaque pointer passed through to sink
+ * @return Continuation offset for paging / live-tailing the log
+ */
+size_t read_events_range(size_t offset, size_t len, ChunkSink sink, void* ctx) {
+  return read_file_range(EVENTS_PATH, offset, len, sink, ctx);
+}
+
+struct FlatBuf {
+  char* data;
+  size_t len;
+};
+
+/**
+ * Copy a block into a flat buffer (ChunkSink adapter).
+ */
+static void flat_sink(const uint8_t* data, size_t len, void* ctx) {
+  FlatBuf* b = (FlatBuf*)ctx;
+  memcpy(b->data + b->len, data, len);
+  b->len += len;
+}
+
+/**
+ * Recover the session state left at the end of events.log.
+ * @param out Receives the song and any clip still open
+ * @return false if there is no log or the tail couldn't be read
+ * @brief Reads at most EVENTS_TAIL_BYTES from the end of the file, so boot
+ *        time doesn't grow with the log. A partial last line (reset during
+ *        an append) is terminated so the next event starts on its own line.
+ */
+bool recover_log_tail(LogTail* out) {
+  memset(out, 0, sizeof(*out));
+  size_t size = events_size();
+  if (!size) return false;
+
+  size_t want = min(size, EVENTS_TAIL_BYTES);
+  FlatBuf buf = { (char*)malloc(want), 0 };
+  if (!buf.data) return false;
+  read_events_range(size - want, want, flat_sink, &buf);
+  log_tail_scan(buf.data, buf.len, want == size, out);
+  free(buf.data);
+
+  // Keep sequence numbers monotonic across resets
+  if (out->stamped && out->lastSeq > g_event_seq) g_event_seq = out->lastSeq;
+
+  if (out->torn) {
+    File f = LittleFS.open(EVENTS_PATH, "a");
+    if (f) {
+      f.print("\r\n");
+      f.close();
+    }
+  }
+  return true;
 }
\ No newline at end of file
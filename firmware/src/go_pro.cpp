@@ -1,23 +1,280 @@
 #include <WiFi.h>
+#include <WiFiUdp.h>
+#include <Preferences.h>
 
+#include "boot_prof.h"
+#include "console.h"
 #include "go_pro.h"
 
+/*
+  LINK SUPERVISOR
+  Runs on its own FreeRTOS task so boot and the main loop never wait on Wi-Fi.
+  DOWN -> CONNECTING -> UP, back to DOWN on loss with exponential backoff.
+  The first attempt after a successful join uses the BSSID/channel/IP cached
+  in NVS (no scan, no DHCP); if that fails the next attempt is a cold join.
+  All camera HTTP also runs on this task: goproShutter() only hands over.
+*/
+static const uint32_t FAST_TIMEOUT_MS = 4000;
+static const uint32_t COLD_TIMEOUT_MS = 12000;
+static const uint32_t BACKOFF_MIN_MS = 250;
+static const uint32_t BACKOFF_MAX_MS = 10000;
+static const uint32_t KEEPALIVE_MS = 2500;
+static const uint32_t TASK_PERIOD_MS = 10;
+static const uint32_t STATUS_RETRY_MS = 1000;
+
+static const char* GOPRO_IP = "10.5.5.9";
+static const uint16_t KEEPALIVE_PORT = 8554;
+static const uint32_t CACHE_MAGIC = 0x4C4E4B31;  // "LNK1"
+
+/**
+ * Last good association, persisted in NVS for fast-path reconnects.
+ */
+struct LinkCache {
+  uint32_t magic;
+  char ssid[33];
+  uint8_t bssid[6];
+  int32_t channel;
+  uint32_t ip, gateway, mask;
+};
+
+static char g_ssid[33] = "";
+static char g_pass[65] = "";
+
+static GoproLink g_link = GOPRO_LINK_DOWN;
+static GoproLinkStats g_stats = {};
+static LinkCache g_cache = {};
+static bool g_cache_valid = false;
+static bool g_attempt_fast = false;
+static uint32_t g_attempt_start = 0;
+static uint32_t g_next_attempt = 0;
+static uint32_t g_backoff = BACKOFF_MIN_MS;
+static uint32_t g_last_keepalive = 0;
+
+static WiFiUDP g_udp;
+
+// Shutter command in flight (set by loop(), cleared by the task once sent).
+// The sync engine holds everything behind it.
+struct ShutterCmd {
+  bool on;
+  uint32_t at;
+};
+static portMUX_TYPE g_shutter_mux = portMUX_INITIALIZER_UNLOCKED;
+static ShutterCmd g_shutter;
+static volatile bool g_shutter_pending = false;
+
+static int g_boot_phase = -1;
+
+// Camera status query (requested by loop(), answered by the task)
+static volatile bool g_status_query = false;
+static volatile int g_camera_recording = -1;
+static uint32_t g_status_next = 0;
+
+static bool sendShutter(bool on);
+static bool queryRecording(int* recording);
+
 /**
- * Connect to GoPro WiFi network and wait for connection.
+ * Load the cached association for the configured SSID from NVS.
+ */
+static void loadLinkCache() {
+  Preferences prefs;
+  if (!prefs.begin("gopro", true)) return;
+  size_t n = prefs.getBytes("link", &g_cache, sizeof(g_cache));
+  prefs.end();
+  g_cache_valid = n == sizeof(g_cache) && g_cache.magic == CACHE_MAGIC &&
+                  strcmp(g_cache.ssid, g_ssid) == 0 && g_cache.ip != 0;
+}
+
+/**
+ * Persist the current association to NVS (only when it changed).
+ */
+static void saveLinkCache() {
+  LinkCache c = {};
+  c.magic = CACHE_MAGIC;
+  strncpy(c.ssid, g_ssid, sizeof(c.ssid) - 1);
+  const uint8_t* bssid = WiFi.BSSID();
+  if (bssid) memcpy(c.bssid, bssid, sizeof(c.bssid));
+  c.channel = WiFi.channel();
+  c.ip = (uint32_t)WiFi.localIP();
+  c.gateway = (uint32_t)WiFi.gatewayIP();
+  c.mask = (uint32_t)WiFi.subnetMask();
+
+  if (g_cache_valid && memcmp(&c, &g_cache, sizeof(c)) == 0) return;
+
+  Preferences prefs;
+  if (!prefs.begin("gopro", false)) return;
+  prefs.putBytes("link", &c, sizeof(c));
+  prefs.end();
+  g_cache = c;
+  g_cache_valid = true;
+}
+
+/**
+ * Kick off one association attempt (returns immediately).
+ * @brief Uses the cached BSSID/channel and static IP when available,
+ *        otherwise a full scan + DHCP join.
+ */
+static void startAttempt() {
+  WiFi.disconnect(false, false);
+
+  g_attempt_fast = g_cache_valid;
+  if (g_attempt_fast) {
+    WiFi.config(IPAddress(g_cache.ip), IPAddress(g_cache.gateway), IPAddress(g_cache.mask));
+    WiFi.begin(g_ssid, g_pass, g_cache.channel, g_cache.bssid, true);
+  } else {
+    WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+    WiFi.begin(g_ssid, g_pass);
+  }
+
+  g_attempt_start = millis();
+  g_link = GOPRO_LINK_CONNECTING;
+}
+
+/**
+ * Schedule the next attempt after the current backoff, then double it.
+ */
+static void scheduleRetry() {
+  g_link = GOPRO_LINK_DOWN;
+  g_next_attempt = millis() + g_backoff;
+  g_backoff = min(g_backoff * 2, BACKOFF_MAX_MS);
+}
+
+/**
+ * Send the GoPro UDP keep-alive so the camera doesn't sleep its Wi-Fi.
+ */
+static void sendKeepAlive() {
+  static const char MSG[] = "_GPHD_:0:0:2:0.000000\n";
+  if (g_udp.beginPacket(GOPRO_IP, KEEPALIVE_PORT)) {
+    g_udp.write((const uint8_t*)MSG, sizeof(MSG) - 1);
+    g_udp.endPacket();
+  }
+}
+
+/**
+ * Drive the link supervisor (one step).
+ * @brief Completes/retries joins with backoff, detects link loss, sends the
+ *        keep-alive while up, and sends the shutter command in flight.
+ */
+static void goproTick() {
+  uint32_t now = millis();
+  bool assoc = WiFi.status() == WL_CONNECTED;
+
+  switch (g_link) {
+    case GOPRO_LINK_DOWN:
+      if ((int32_t)(now - g_next_attempt) >= 0) startAttempt();
+      break;
+
+    case GOPRO_LINK_CONNECTING: {
+      uint32_t took = now - g_attempt_start;
+      if (assoc) {
+        g_link = GOPRO_LINK_UP;
+        g_backoff = BACKOFF_MIN_MS;
+        g_last_keepalive = 0;
+        g_stats.connects++;
+        if (g_attempt_fast) { g_stats.fastConnects++; g_stats.lastFastMs = took; }
+        else { g_stats.coldConnects++; g_stats.lastColdMs = took; }
+        console_printf("[WiFi] connected (%s) in %u ms\n",
+                      g_attempt_fast ? "cached" : "cold", (unsigned)took);
+        boot_phase_end(g_boot_phase);
+        saveLinkCache();
+      } else if (took >= (g_attempt_fast ? FAST_TIMEOUT_MS : COLD_TIMEOUT_MS)) {
+        console_printf("[WiFi] %s join timed out after %u ms\n",
+                      g_attempt_fast ? "cached" : "cold", (unsigned)took);
+        if (g_attempt_fast) g_cache_valid = false;  // AP moved; next try is cold
+        boot_phase_end(g_boot_phase);
+        scheduleRetry();
+      }
+      break;
+    }
+
+    case GOPRO_LINK_UP:
+      if (!assoc) {
+        g_stats.drops++;
+        console_println("[WiFi] link lost, reconnecting");
+        g_backoff = BACKOFF_MIN_MS;
+        scheduleRetry();
+        break;
+      }
+      if (g_last_keepalive == 0 || now - g_last_keepalive >= KEEPALIVE_MS) {
+        g_last_keepalive = now;
+        sendKeepAlive();
+      }
+      break;
+  }
+
+  // Status first: it describes the camera before a shutter command runs
+  if (g_status_query && g_link == GOPRO_LINK_UP && (int32_t)(now - g_status_next) >= 0) {
+    int rec = -1;
+    if (queryRecording(&rec)) {
+      g_camera_recording = rec;
+      g_status_query = false;
+      console_printf("[GoPro] status: %s\n", rec ? "recording" : "idle");
+    } else {
+      g_status_next = millis() + STATUS_RETRY_MS;
+    }
+  }
+
+  if (g_shutter_pending && g_link == GOPRO_LINK_UP) {
+    portENTER_CRITICAL(&g_shutter_mux);
+    ShutterCmd cmd = g_shutter;
+    portEXIT_CRITICAL(&g_shutter_mux);
+
+    bool ok = sendShutter(cmd.on);
+    g_stats.lastShutterOn = cmd.on;
+    g_stats.lastShutterOk = ok;
+    g_stats.shutterSent++;
+    console_printf("[GoPro] camera %s %s (%u ms after dispatch)\n", cmd.on ? "START" : "STOP",
+                   ok ? "ok" : "FAIL", (unsigned)(millis() - cmd.at));
+    g_shutter_pending = false;
+  }
+}
+
+/**
+ * Wi-Fi supervisor task body.
+ */
+static void goproTask(void* arg) {
+  (void)arg;
+  WiFi.persistent(false);       // we keep our own cache in NVS
+  WiFi.setAutoReconnect(false); // reconnects are driven by goproTick()
+  WiFi.mode(WIFI_STA);
+
+  loadLinkCache();
+  startAttempt();
+
+  for (;;) {
+    goproTick();
+    vTaskDelay(pdMS_TO_TICKS(TASK_PERIOD_MS));
+  }
+}
+
+/**
+ * Start the Wi-Fi link supervisor for the GoPro access point.
  * @param ssid GoPro WiFi SSID (e.g., "GP26354747")
  * @param pass GoPro WiFi password
- * @return true if connected successfully, false if timeout (12 seconds)
- * @brief Initiates WiFi connection to GoPro with 12-second timeout.
+ * @brief Non-blocking: spawns the supervisor task (core 0, next to the BLE
+ *        host) and returns. The first join is timed as the "wifi" boot phase.
  */
-bool goproBegin(const char* ssid, const char* pass) {
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(ssid, pass);
+void goproBegin(const char* ssid, const char* pass) {
+  strncpy(g_ssid, ssid, sizeof(g_ssid) - 1);
+  strncpy(g_pass, pass, sizeof(g_pass) - 1);
+
+  g_boot_phase = boot_phase_begin("wifi");
+  xTaskCreatePinnedToCore(goproTask, "gopro", 6144, nullptr, 1, nullptr, 0);
+}
 
-  unsigned long t0 = millis();
-  while (WiFi.status() != WL_CONNECTED && millis() - t0 < 12000) {
-    delay(50);
+GoproLink goproLinkState() {
+  return g_link;
+}
+
+const char* goproLinkName(GoproLink s) {
+  switch (s) {
+    case GOPRO_LINK_UP: return "up";
+    case GOPRO_LINK_CONNECTING: return "connecting";
+    default: return "down";
   }
-  return WiFi.status() == WL_CONNECTED;
+}
+
+const GoproLinkStats& goproLinkStats() {
+  return g_stats;
 }
 
 /**
@@ -73,8 +330,8 @@ static bool httpGETtoBuf(const char* path, char* body, size_t cap) {
  * @brief Sends /gp/gpControl/command/shutter API call to GoPro.
  *        Logs debug info including HTTP response body.
  */
-bool goproShutter(bool on) {
-  Serial.printf("[GoPro] Sending shutter command: %s\n", on ? "START" : "STOP");
+static bool sendShutter(bool on) {
+  console_printf("[GoPro] Sending shutter command: %s\n", on ? "START" : "STOP");
   
   char path[64];
   snprintf(path, sizeof(path),
@@ -85,10 +342,71 @@ bool goproShutter(bool on) {
   bool result = httpGETtoBuf(path, body, sizeof(body));
   
   if (result) {
-    Serial.printf("[GoPro] HTTP response: %s\n", body);
+    console_printf("[GoPro] HTTP response: %s\n", body);
   } else {
-    Serial.println("[GoPro] HTTP request failed");
+    console_println("[GoPro] HTTP request failed");
   }
   
   return result;
 }
+
+/**
+ * Read the camera's recording state from its status endpoint.
+ * @param recording Receives 1 if the camera is encoding, 0 if idle
+ * @return false if the request failed or the field wasn't found
+ * @brief Status field 8 ("is busy/encoding") comes early in the "status"
+ *        object, so a short prefix of the body is enough.
+ */
+static bool queryRecording(int* recording) {
+  char body[384];
+  if (!httpGETtoBuf("/gp/gpControl/status", body, sizeof(body))) return false;
+
+  const char* p = strstr(body, "\"8\":");
+  if (!p) return false;
+  *recording = atoi(p + 4) ? 1 : 0;
+  return true;
+}
+
+/**
+ * Request a recording-state query (any task, non-blocking).
+ * @brief Answered on the supervisor task once the link is up; poll
+ *        goproCameraRecording() for the result.
+ */
+void goproQueryRecording() {
+  g_camera_recording = -1;
+  g_status_next = 0;
+  g_status_query = true;
+}
+
+int goproCameraRecording() {
+  return g_camera_recording;
+}
+
+/**
+ * Start or stop recording.
+ * @param on true to start recording, false to stop recording
+ * @return false if a command is still in flight (the caller keeps this one)
+ * @brief Safe from any task; never blocks. The sync engine queues, collapses
+ *        and expires commands, and hands one over only while
+ *        goproShutterIdle(). The supervisor task sends it and logs the
+ *        camera's answer.
+ */
+bool goproShutter(bool on) {
+  bool taken = false;
+  portENTER_CRITICAL(&g_shutter_mux);
+  if (!g_shutter_pending) {
+    g_shutter.on = on;
+    g_shutter.at = millis();
+    g_shutter_pending = true;
+    taken = true;
+  }
+  portEXIT_CRITICAL(&g_shutter_mux);
+  return taken;
+}
+
+/**
+ * No command in flight: goproShutter() would take a new one.
+ */
+bool goproShutterIdle() {
+  return !g_shutter_pending;
+}
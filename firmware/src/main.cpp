@@ -1,24 +1,34 @@
 #include <Arduino.h>
-#include <ctype.h>
 #include <string.h>
-#include <strings.h>
 #include <stdlib.h>
 #include <LittleFS.h>
 #include <NimBLEDevice.h>
 
 #include "app_state.h"
+#include "ble_inbox.h"
+#include "boot_prof.h"
+#include "console.h"
+#include "event_log.h"
 #include "go_pro.h"
+#include "offload.h"
+#include "songtime_log.h"
+#include "status_channel.h"
+#include "text_util.h"
+#include "trace_capture.h"
+#include "xml_export.h"
 
 /*
   EXTERNAL HOOKS
 */
-extern void log_song(const String& uri, const String& title, uint32_t durationMs);
-extern void log_clip_start(const String& filename, uint32_t songMs);
-extern void log_clip_end(const String& filename, uint32_t songMs);
+extern void log_song(const char* uri, const char* title, uint32_t durationMs);
+extern void log_clip_start(const char* filename, uint32_t songMs);
+extern void log_clip_end(const char* filename, uint32_t songMs);
+extern void log_clip_gap(const char* filename, uint32_t fromMs, uint32_t toMs, uint32_t pauseMs);
+extern void log_clip_at(const char* filename, uint32_t songMs);
+extern void log_clip_recovered(const char* filename, uint32_t songMs);
+extern void log_clip_lost(const char* filename, uint32_t songMs);
 extern void clear_events();
-extern String read_events();
-extern bool export_xml_from_events(const String& eventsText);
-extern String read_project_xml();
+extern bool export_project();
 
 /*
   GLOBALS
@@ -36,198 +46,256 @@ static const char* UUID_TX  = "6E400003-B5A3-F393-E0A9-E50E24DCCA9E"; // notify
 static NimBLECharacteristic* g_ble_tx = nullptr;
 static bool g_ble_subscribed = false;
 static bool g_ble_send_xml_pending = false;
+static volatile bool g_ble_send_boot_pending = false;
+static const char* g_ble_send_xml_path = nullptr;
 
-// Defer GoPro commands
-static bool g_gopro_start_pending = false;
-static bool g_gopro_stop_pending = false;
+// Inbound BLE writes, queued by the BLE task for loop() (see BLE INBOX)
+static portMUX_TYPE g_inbox_mux = portMUX_INITIALIZER_UNLOCKED;
+static BleInbox g_inbox;
 
 /*
-  "Whole song" mode state (ADDED)
+  RANGED LOG READS
+  r                  -> whole log (streamed)
+  r <offset> [len]   -> one page, answered with a continuation offset
+  rt <len>           -> last <len> bytes
+  rf [offset]        -> live-tail from offset (default: current end)
+  rs                 -> stop live-tail
 */
-static bool g_playing = false;          // set by p1/p0 from phone
-static bool g_song_has_meta = false;    // set after metadata received
-static bool g_song_recording = false;   // are we recording this song?
-static String g_song_filename = "";     // filename used for clip start/end
+static const size_t LOG_PAGE_MAX = 4096;      // cap per BLE page
+static const uint32_t LOG_FOLLOW_POLL_MS = 250;
+
+struct LogRequest {
+  volatile bool pending;
+  bool toBle;
+  size_t offset;
+  size_t len;
+};
+static LogRequest g_log_req = { false, false, 0, 0 };
+
+static volatile bool g_log_follow = false;
+static bool g_log_follow_ble = false;
+static size_t g_log_follow_offset = 0;
+static uint32_t g_log_follow_last_ms = 0;
 
 /*
-  UTILS
+  BLE TX HELPERS
 */
 /**
- * Safe string copy with null termination.
- * @param dst Destination buffer
- * @param dst_sz Size of destination buffer (including null terminator)
- * @param src Source string (can be NULL)
- * @brief Safely copies src to dst with bounds checking and null termination
+ * Packetizes a byte stream into "<TAG>_CHUNK <seq> <data>" notifications.
+ * @brief Fed block-by-block from LittleFS so large files never sit in RAM.
  */
-static void safe_copy(char* dst, size_t dst_sz, const char* src) {
-  if (!dst || dst_sz == 0) return;
-  if (!src) { dst[0] = '\0'; return; }
-  strncpy(dst, src, dst_sz - 1);
-  dst[dst_sz - 1] = '\0';
-}
+struct BleChunker {
+  const char* tag;
+  int seq;
+  size_t fill;
+  char data[140];
+};
+
+static const int BLE_CHUNK = 140;
 
 /**
- * Trim leading and trailing whitespace from a string in-place.
- * @param s String to trim (modifies in place)
- * @brief Removes all leading and trailing whitespace characters
+ * Notify one "<TAG>_CHUNK" packet with the bytes buffered in the chunker.
+ * @param ck Chunker holding up to BLE_CHUNK bytes
  */
-static void trim_inplace(char* s) {
-  if (!s) return;
-  char* p = s;
-  while (*p && isspace((unsigned char)*p)) p++;
-  if (p != s) memmove(s, p, strlen(p) + 1);
-  size_t n = strlen(s);
-  while (n > 0 && isspace((unsigned char)s[n - 1])) {
-    s[n - 1] = '\0';
-    n--;
+static void ble_chunker_flush(BleChunker* ck) {
+  if (ck->fill == 0) return;
+
+  static char buf[200];
+  int headerLen = snprintf(buf, sizeof(buf), "%s_CHUNK %d ", ck->tag, ck->seq);
+
+  if (headerLen + (int)ck->fill < (int)sizeof(buf)) {
+    memcpy(buf + headerLen, ck->data, ck->fill);
+    g_ble_tx->setValue((uint8_t*)buf, headerLen + ck->fill);
+    g_ble_tx->notify();
   }
+
+  ck->seq++;
+  ck->fill = 0;
+  delay(20);
 }
 
 /**
- * Parse unsigned 32-bit integer from string.
- * @param s Input string (can be NULL)
- * @return Parsed value, or 0 if string is NULL or invalid
- * @brief Converts decimal string to uint32_t
+ * ChunkSink adapter: buffer file blocks and emit full BLE chunks.
  */
-static uint32_t parse_u32(const char* s) {
-  if (!s) return 0;
-  return (uint32_t)strtoul(s, nullptr, 10);
+static void ble_chunk_sink(const uint8_t* data, size_t len, void* ctx) {
+  BleChunker* ck = (BleChunker*)ctx;
+  while (len) {
+    size_t n = min((size_t)BLE_CHUNK - ck->fill, len);
+    memcpy(ck->data + ck->fill, data, n);
+    ck->fill += n;
+    data += n;
+    len -= n;
+    if (ck->fill == (size_t)BLE_CHUNK) ble_chunker_flush(ck);
+  }
 }
 
 /**
- * Check if all bytes in a buffer are ASCII digits.
- * @param d Data buffer
- * @param n Number of bytes to check
- * @return true if all bytes are '0'-'9', false otherwise
- * @brief Used to distinguish time commands (digits) from text commands
+ * ChunkSink adapter: write file blocks straight to the UART.
  */
-static bool is_all_digits(const uint8_t* d, size_t n) {
-  if (!d || n == 0) return false;
-  for (size_t i = 0; i < n; i++)
-    if (d[i] < '0' || d[i] > '9') return false;
-  return true;
+static void serial_chunk_sink(const uint8_t* data, size_t len, void* ctx) {
+  (void)ctx;
+  Serial.write(data, len);
 }
 
 /**
- * Check if all bytes are printable ASCII (space-tilde, plus tab/CR/LF).
- * @param d Data buffer
- * @param n Number of bytes to check
- * @return true if all bytes are printable ASCII, false if contains control chars
- * @brief Validates BLE data before parsing as text commands
+ * Send a text notification on the TX characteristic.
+ * @param line Null-terminated message
  */
-static bool is_printable_ascii(const uint8_t* d, size_t n) {
-  if (!d || n == 0) return false;
-  for (size_t i = 0; i < n; i++) {
-    uint8_t c = d[i];
-    if (c == '\r' || c == '\n' || c == '\t') continue;
-    if (c < 32 || c > 126) return false;
-  }
-  return true;
+static void ble_notify_line(const char* line) {
+  g_ble_tx->setValue((uint8_t*)line, strlen(line));
+  g_ble_tx->notify();
 }
 
-/*
-  BLE TX HELPERS
-*/
 /**
- * Send XML data via BLE in chunks to avoid overwhelming the BLE stack.
- * @param xml Complete XML string to send
- * @brief Splits XML into 140-byte chunks with sequence numbers and sends via BLE notify.
+ * Send an export file via BLE in chunks to avoid overwhelming the BLE stack.
+ * @param path Export file to send (/project.xml, .fcpxml, .edl or .otio)
+ * @brief Streams the file in 140-byte chunks with sequence numbers via BLE notify.
  *        Sends begin marker, chunks, and end marker for reassembly on client.
  */
-static void ble_send_xml_chunks(const String& xml) {
+static void ble_send_xml_chunks(const char* path) {
   if (!g_ble_tx || !g_ble_subscribed) return;
 
-  const int CHUNK = 140;
-  const int total = xml.length();
-  int seq = 0;
+  char buf[48];
+  snprintf(buf, sizeof(buf), "XML_BEGIN %u", (unsigned)file_size(path));
+  ble_notify_line(buf);
+  delay(20);
+
+  BleChunker ck = { "XML", 0, 0, {0} };
+  read_file_range(path, 0, SIZE_MAX, ble_chunk_sink, &ck);
+  ble_chunker_flush(&ck);
 
-  static char buf[200];
+  snprintf(buf, sizeof(buf), "XML_END %d", ck.seq);
+  ble_notify_line(buf);
+}
 
-  snprintf(buf, sizeof(buf), "XML_BEGIN %d", total);
-  g_ble_tx->setValue((uint8_t*)buf, strlen(buf));
-  g_ble_tx->notify();
+/**
+ * Send one page of events.log via BLE.
+ * @param offset First byte of the page
+ * @param len Page length (capped at LOG_PAGE_MAX)
+ * @return Continuation offset
+ * @brief Protocol: "LOG_BEGIN <offset> <size>", "LOG_CHUNK <seq> <data>"...,
+ *        "LOG_END <chunks> <next>". The phone requests the next page with
+ *        "r <next> <len>" until next == size.
+ */
+static size_t ble_send_log_page(size_t offset, size_t len) {
+  if (!g_ble_tx || !g_ble_subscribed) return offset;
+  if (len > LOG_PAGE_MAX) len = LOG_PAGE_MAX;
+
+  char buf[64];
+  snprintf(buf, sizeof(buf), "LOG_BEGIN %u %u", (unsigned)offset, (unsigned)events_size());
+  ble_notify_line(buf);
   delay(20);
 
-  for (int i = 0; i < total; i += CHUNK) {
-    int len = min(CHUNK, total - i);
-    int headerLen = snprintf(buf, sizeof(buf), "XML_CHUNK %d ", seq);
+  BleChunker ck = { "LOG", 0, 0, {0} };
+  size_t next = read_events_range(offset, len, ble_chunk_sink, &ck);
+  ble_chunker_flush(&ck);
 
-    if (headerLen + len < (int)sizeof(buf)) {
-      memcpy(buf + headerLen, xml.c_str() + i, len);
-      g_ble_tx->setValue((uint8_t*)buf, headerLen + len);
-      g_ble_tx->notify();
-    }
+  snprintf(buf, sizeof(buf), "LOG_END %d %u", ck.seq, (unsigned)next);
+  ble_notify_line(buf);
+  return next;
+}
 
-    seq++;
-    delay(20);
-  }
+/**
+ * Serve a ranged log request on the requesting transport.
+ * @param toBle true to answer via BLE notify, false via Serial
+ * @param offset First byte
+ * @param len Maximum length
+ * @return Continuation offset
+ */
+static size_t send_log_range(bool toBle, size_t offset, size_t len) {
+  if (toBle) return ble_send_log_page(offset, len);
 
-  snprintf(buf, sizeof(buf), "XML_END %d", seq);
-  g_ble_tx->setValue((uint8_t*)buf, strlen(buf));
-  g_ble_tx->notify();
+  size_t next = read_events_range(offset, len, serial_chunk_sink, nullptr);
+  Serial.printf("\nLOG_NEXT %u\n", (unsigned)next);
+  return next;
 }
 
-/*
-  METADATA PARSER
-  Format sent from iPhone: "muri=...;title=...;dur=..."
-*/
 /**
- * Parse and store song metadata from BLE/Serial input.
- * @param payload Format: "uri=<uri>;title=<title>;dur=<milliseconds>"
- * @brief Extracts Spotify URI, song title, and duration.
- *        Logs metadata and resets recording state for new song.
+ * Push newly appended log bytes while live-tail is active.
+ * @brief Polled from loop(); only reads the bytes past the follow offset.
  */
-static void parse_and_set_metadata(char* payload) {
-  trim_inplace(payload);
-  if (*payload == '\0') {
-    Serial.println("metadata: empty");
+static void log_follow_tick() {
+  if (!g_log_follow) return;
+  if (millis() - g_log_follow_last_ms < LOG_FOLLOW_POLL_MS) return;
+  g_log_follow_last_ms = millis();
+
+  if (g_log_follow_ble && !g_ble_subscribed) {
+    g_log_follow = false;
     return;
   }
 
-  // Reset song state on new metadata
-  g_song_has_meta = false;
-
-  char* save = nullptr;
-  for (char* tok = strtok_r(payload, ";", &save);
-       tok;
-       tok = strtok_r(nullptr, ";", &save)) {
-
-    trim_inplace(tok);
-    char* eq = strchr(tok, '=');
-    if (!eq) continue;
-
-    *eq = '\0';
-    char* key = tok;
-    char* val = eq + 1;
-    trim_inplace(key);
-    trim_inplace(val);
-
-    if (strcasecmp(key, "uri") == 0) {
-      safe_copy(g_song.uri, sizeof(g_song.uri), val);
-    } else if (strcasecmp(key, "title") == 0) {
-      safe_copy(g_song.title, sizeof(g_song.title), val);
-    } else if (strcasecmp(key, "dur") == 0 || strcasecmp(key, "duration") == 0) {
-      g_song.durationMs = parse_u32(val);
-    }
-  }
+  size_t size = events_size();
+  if (size < g_log_follow_offset) g_log_follow_offset = 0;  // log was cleared
+  if (size == g_log_follow_offset) return;
 
-  Serial.printf(
-    "Song meta set: uri=\"%s\" title=\"%s\" durationMs=%u\n",
-    g_song.uri, g_song.title, (unsigned)g_song.durationMs
-  );
+  g_log_follow_offset = send_log_range(g_log_follow_ble, g_log_follow_offset,
+                                       size - g_log_follow_offset);
+}
 
-  log_song(String(g_song.uri), String(g_song.title), g_song.durationMs);
+/**
+ * Parse the arguments of an "r" command and queue or serve it.
+ * @param args Text after the leading 'r'
+ * @param fromBle true if the command arrived over BLE
+ * @brief BLE requests are deferred to loop() (notify + delay must not run in
+ *        the BLE task); serial requests are served immediately.
+ */
+static void handle_read_command(char* args, bool fromBle) {
+  char mode = *args;
+  if (mode == 't' || mode == 'f' || mode == 's') args++;
+  trim_inplace(args);
+
+  char* end = nullptr;
+  size_t a = (size_t)strtoul(args, &end, 10);
+  bool hasA = end != args;
+  size_t b = hasA ? (size_t)strtoul(end, &end, 10) : 0;
+  bool hasB = hasA && b > 0;
+
+  size_t size = events_size();
+  size_t offset = 0;
+  size_t len = SIZE_MAX;
+
+  switch (mode) {
+    case 's':
+      g_log_follow = false;
+      Serial.println("[LOG] follow stopped");
+      return;
+
+    case 'f':
+      g_log_follow_offset = hasA ? a : size;
+      g_log_follow_ble = fromBle;
+      g_log_follow_last_ms = 0;
+      g_log_follow = true;
+      Serial.printf("[LOG] follow from %u\n", (unsigned)g_log_follow_offset);
+      return;
+
+    case 't':
+      len = hasA ? a : 1024;
+      offset = (len < size) ? size - len : 0;
+      break;
 
-  // New song => stop old recording state (if any)
-  if (g_song_recording) {
-    g_song_recording = false;
-    g_gopro_stop_pending = true;
-    log_clip_end(g_song_filename, g_songTimeMs);
+    default:
+      if (!hasA) {
+        if (!fromBle) {  // plain "r" on serial: whole log, as before
+          read_events_range(0, SIZE_MAX, serial_chunk_sink, nullptr);
+          Serial.println();
+          return;
+        }
+        len = LOG_PAGE_MAX;
+      } else {
+        offset = a;
+        len = hasB ? b : (fromBle ? LOG_PAGE_MAX : SIZE_MAX);
+      }
+      break;
   }
 
-  // Prepare filename for this song session
-  g_song_filename = "song_" + String(millis()) + ".mp4";
-  g_song_has_meta = true;
+  if (fromBle) {
+    g_log_req.toBle = true;
+    g_log_req.offset = offset;
+    g_log_req.len = len;
+    g_log_req.pending = true;
+  } else {
+    send_log_range(false, offset, len);
+  }
 }
 
 /*
@@ -237,53 +305,142 @@ static void parse_and_set_metadata(char* payload) {
  * Parse and execute commands received from Serial/BLE.
  * @param line Command line to execute
  * @brief Processes commands:
- *        - m<metadata>: Set song metadata
- *        - p0/p1: Playback pause/play
- *        - x: Export events to XML
- *        - r: Read event log
+ *        - m<metadata>: Set song metadata (sync engine)
+ *        - p0/p1: Playback pause/play (sync engine)
+ *        - x [xml|fcpxml|edl|otio]: Export timelines, send the chosen format
+ *        - r [offset [len]] / rt / rf / rs: Ranged, tail and follow log reads
  *        - c: Clear event log
+ *        - b: Boot-phase profile (time-to-advertise, per-phase durations)
+ *        - s: Sync engine counters (metadata suppression, pauses, shutter)
+ *        - h [ms]: Show / set the pause hold (shorter pauses keep recording)
+ *        - o [baud] [path]: Serial bulk offload of session files (serial only)
+ *        - w: Camera Wi-Fi link state and reconnect timings
+ *        - T1 / T0 / Tr: Start / stop / dump inbound message trace capture
+ * @param fromBle true if the line arrived over BLE (answers go to notify)
  */
-static void handle_command_line(char* line) {
+static void handle_command_line(char* line, bool fromBle) {
   trim_inplace(line);
   if (*line == '\0') return;
 
-  switch (line[0]) {
+  if (g_sync.handle_command(line)) return;
 
-    case 'm': // metadata
-      parse_and_set_metadata(line + 1);
-      break;
+  switch (line[0]) {
 
-    case 'p': { // playback state: p1 / p0 (ADDED)
-      if (line[1] == '1') {
-        g_playing = true;
-        Serial.println("[PLAYBACK] PLAY");
-      } else {
-        g_playing = false;
-        Serial.println("[PLAYBACK] PAUSE/STOP");
+    case 'x': { // export xml (+ fcpxml/edl/otio), send the requested format
+      char* fmt = line + 1;
+      trim_inplace(fmt);
+      const char* path = export_path(fmt);
+      if (!path) {
+        Serial.printf("Unknown export format: %s\n", fmt);
+        break;
       }
-      break;
-    }
 
-    case 'x': { // export xml
-      export_xml_from_events(read_events());
+      export_project();
       if (g_ble_subscribed) {
+        g_ble_send_xml_path = path;
         g_ble_send_xml_pending = true;
         Serial.println("[BLE] XML export queued");
       } else {
-        Serial.println(read_project_xml());
+        read_file_range(path, 0, SIZE_MAX, serial_chunk_sink, nullptr);
+        Serial.println();
       }
       break;
     }
 
     case 'r':
-      Serial.println(read_events());
+      handle_read_command(line + 1, fromBle);
       break;
 
     case 'c':
       clear_events();
+      songtime_clear();
       Serial.println("events.log cleared.");
       break;
 
+    case 'b': // boot profile
+      if (fromBle) g_ble_send_boot_pending = true;
+      else boot_report(Serial);
+      break;
+
+    case 's': { // sync engine counters
+      const SyncStats& st = g_sync.stats();
+      Serial.printf("[SYNC] meta applied=%u duplicate=%u stale=%u deferred=%u\n",
+                    (unsigned)st.metaApplied, (unsigned)st.metaDuplicate,
+                    (unsigned)st.metaStale, (unsigned)st.metaDeferred);
+      Serial.printf("[SYNC] pauses bridged=%u, shutter pairs cancelled=%u expired=%u, hold=%u ms\n",
+                    (unsigned)st.pausesBridged, (unsigned)st.shutterPairsCancelled,
+                    (unsigned)st.shutterExpired, (unsigned)g_sync.pause_hold());
+      Serial.printf("[SYNC] clips recovered=%u resumed=%u\n",
+                    (unsigned)st.clipsRecovered, (unsigned)st.clipsResumed);
+      Serial.printf("[SYNC] ble writes dropped=%u (inbox full)\n", (unsigned)g_inbox.dropped());
+      Serial.printf("[SYNC] songtime %u B, dropped=%u B\n",
+                    (unsigned)songtime_size(), (unsigned)songtime_dropped());
+      break;
+    }
+
+    case 'h': { // pause hold (hysteresis) in ms
+      char* arg = line + 1;
+      trim_inplace(arg);
+      if (*arg) {
+        if (!is_all_digits((const uint8_t*)arg, strlen(arg))) {
+          Serial.println("Usage: h [ms]");
+          break;
+        }
+        g_sync.set_pause_hold(parse_u32(arg));
+      }
+      Serial.printf("[SYNC] pause hold %u ms\n", (unsigned)g_sync.pause_hold());
+      break;
+    }
+
+    case 'o': { // serial bulk offload: o [baud] [path]
+      if (fromBle) {
+        Serial.println("[OFFLOAD] serial only");
+        break;
+      }
+      char* arg = line + 1;
+      trim_inplace(arg);
+      uint32_t baud = OFFLOAD_DEFAULT_BAUD;
+      if (isdigit((unsigned char)*arg)) {
+        baud = parse_u32(arg);
+        while (isdigit((unsigned char)*arg)) arg++;
+        trim_inplace(arg);
+      }
+      if (baud < 9600 || baud > 5000000) {
+        Serial.println("Usage: o [baud] [path]");
+        break;
+      }
+      offload_run(baud, *arg ? arg : nullptr);
+      break;
+    }
+
+    case 'w': { // camera Wi-Fi link status
+      const GoproLinkStats& st = goproLinkStats();
+      Serial.printf("[WiFi] link=%s connects=%u (cached %u, last %u ms; cold %u, last %u ms) "
+                    "drops=%u\n",
+                    goproLinkName(goproLinkState()), (unsigned)st.connects,
+                    (unsigned)st.fastConnects, (unsigned)st.lastFastMs,
+                    (unsigned)st.coldConnects, (unsigned)st.lastColdMs,
+                    (unsigned)st.drops);
+      break;
+    }
+
+    case 'T': // trace capture
+      if (line[1] == '1') {
+        trace_start();
+        Serial.println("[TRACE] capture started (/trace.log)");
+      } else if (line[1] == '0') {
+        trace_stop();
+        Serial.printf("[TRACE] capture stopped, %u bytes, %u dropped\n",
+                      (unsigned)trace_size(), (unsigned)trace_dropped());
+      } else if (line[1] == 'r') {
+        read_trace_range(0, SIZE_MAX, serial_chunk_sink, nullptr);
+        Serial.println();
+      } else {
+        Serial.printf("[TRACE] %s, %u bytes\n", trace_active() ? "on" : "off",
+                      (unsigned)trace_size());
+      }
+      break;
+
     default:
       Serial.print("Unknown command: ");
       Serial.println(line);
@@ -292,35 +449,49 @@ static void handle_command_line(char* line) {
 }
 
 /*
-  BLE WRITE ENTRY POINT
+  BLE INBOX
+  NimBLE callbacks run on the BLE host task, but the sync engine, the log and
+  everything else handle_command_line() touches belong to loop(). Writes are
+  queued in a BleInbox (sync lib, shared with msync-syncsim) and drained at
+  the top of loop(), in arrival order.
 */
 /**
  * Handle incoming BLE write events from NUS RX characteristic.
  * @param data Received data bytes
  * @param len Number of bytes received
- * @brief Routes digit-only data to songTimeMs update, other data to command parser.
- *        Called in BLE task context; commands are deferred to main loop.
+ * @brief Called in BLE task context. Only records the write (trace, song-time
+ *        trace) and queues it; ble_inbox_poll() on loop() routes digit-only
+ *        data to the song time and other text to the command parser.
  */
 void handle_ble_write(const uint8_t* data, size_t len) {
   if (!data || len == 0) return;
+  trace_record('B', data, len);
 
-  // Digits-only => song time ms
-  if (is_all_digits(data, len)) {
-    char tmp[32];
-    size_t n = (len < sizeof(tmp) - 1) ? len : sizeof(tmp) - 1;
-    memcpy(tmp, data, n);
-    tmp[n] = '\0';
-    g_songTimeMs = parse_u32(tmp);
-    Serial.printf("[BLE] songTimeMs = %u\n", (unsigned)g_songTimeMs);
-    return;
-  }
+  BleInboxMsg m;
+  if (!BleInbox::parse(data, len, millis(), &m)) return;
+  if (m.time) songtime_record(m.songMs);
+
+  portENTER_CRITICAL(&g_inbox_mux);
+  g_inbox.push(m);
+  portEXIT_CRITICAL(&g_inbox_mux);
+}
 
-  if (is_printable_ascii(data, len)) {
-    char buf[256];
-    size_t n = (len < sizeof(buf) - 1) ? len : sizeof(buf) - 1;
-    memcpy(buf, data, n);
-    buf[n] = '\0';
-    handle_command_line(buf);
+/**
+ * Run queued BLE writes on the main loop.
+ */
+static void ble_inbox_poll() {
+  static BleInboxMsg m;
+  for (;;) {
+    portENTER_CRITICAL(&g_inbox_mux);
+    bool got = g_inbox.pop(&m);
+    portEXIT_CRITICAL(&g_inbox_mux);
+    if (!got) return;
+
+    if (!ble_inbox_route(g_sync, m)) {
+      handle_command_line(m.line, true);
+    } else if (m.time) {
+      Serial.printf("[BLE] songTimeMs = %u\n", (unsigned)m.songMs);
+    }
   }
 }
 
@@ -335,7 +506,7 @@ class TxCallbacks : public NimBLECharacteristicCallbacks {
   void onSubscribe(NimBLECharacteristic* chr, ble_gap_conn_desc* desc, uint16_t subValue) override {
     (void)chr; (void)desc;
     g_ble_subscribed = (subValue & 0x0001) != 0;
-    Serial.printf("[BLE] notify subscribed=%d\n", g_ble_subscribed ? 1 : 0);
+    console_printf("[BLE] notify subscribed=%d\n", g_ble_subscribed ? 1 : 0);
   }
 };
 
@@ -368,7 +539,8 @@ static void serial_poll() {
     if (ch == '\n' || ch == '\r') {
       if (linepos) {
         linebuf[linepos] = '\0';
-        handle_command_line(linebuf);
+        trace_record('S', (const uint8_t*)linebuf, linepos);
+        handle_command_line(linebuf, false);
         linepos = 0;
       }
     } else if (linepos < sizeof(linebuf) - 1) {
@@ -378,62 +550,115 @@ static void serial_poll() {
 }
 
 /*
-  WHOLE SONG SCHEDULER (ADDED)
+  SYNC ENGINE HOOKS
 */
+static uint32_t hook_now_ms() {
+  return millis();
+}
+
+static void hook_print(const char* line) {
+  Serial.println(line);
+}
+
 /**
- * Auto-record entire song when playback is active.
- * @brief Manages recording start/stop based on playback state and song timing.
- *        Starts recording at song start, stops at song end or if playback is paused.
+ * Camera availability for the sync engine's shutter queue.
+ * @brief Commands are handed to the Wi-Fi task only while it is idle on an
+ *        up link, so pairs issued meanwhile still cancel in the engine.
  */
-static void whole_song_tick() {
-  if (!g_song_has_meta) return;
-
-  // If paused/stopped, stop recording (if active)
-  if (!g_playing && g_song_recording) {
-    g_song_recording = false;
-    g_gopro_stop_pending = true;
-    log_clip_end(g_song_filename, g_songTimeMs);
-    Serial.println("[SONG] -> GoPro STOP (playback stopped)");
-    return;
+static int hook_camera_state() {
+  switch (goproLinkState()) {
+    case GOPRO_LINK_UP:
+      return goproShutterIdle() ? SYNC_CAMERA_READY : SYNC_CAMERA_BUSY;
+    case GOPRO_LINK_CONNECTING:
+      return SYNC_CAMERA_BUSY;
+    default:
+      return SYNC_CAMERA_DOWN;
   }
+}
 
-  // Start recording near the beginning once playback is playing
-  if (g_playing && !g_song_recording) {
-    // "start condition": we are playing and time is near start (or we just started)
-    if (g_songTimeMs <= 1500) {
-      g_song_recording = true;
-      g_gopro_start_pending = true;
-      log_clip_start(g_song_filename, g_songTimeMs);
-      Serial.println("[SONG] -> GoPro START (song begin)");
-    }
-  }
+static const SyncHooks SYNC_HOOKS = {
+  hook_now_ms,
+  log_song,
+  log_clip_start,
+  log_clip_end,
+  log_clip_gap,
+  log_clip_at,
+  log_clip_recovered,
+  log_clip_lost,
+  goproShutter,
+  hook_print,
+  hook_camera_state,
+};
 
-  // Stop recording at song end
-  if (g_song_recording && g_song.durationMs > 0) {
-    if (g_songTimeMs + 200 >= g_song.durationMs) { // small margin
-      g_song_recording = false;
-      g_gopro_stop_pending = true;
-      log_clip_end(g_song_filename, g_songTimeMs);
-      Serial.println("[SONG] -> GoPro STOP (song end)");
-    }
+/*
+  CRASH RECOVERY
+  A reset mid-recording leaves a CLIP_START with no CLIP_END. At boot only the
+  log tail is read to restore it; the clip is resumed if the camera says it is
+  still recording, otherwise closed at its last CLIP_AT checkpoint.
+*/
+static const uint32_t RECOVERY_TIMEOUT_MS = 20000;  // wait for the camera status
+static uint32_t g_recovery_deadline = 0;
+
+/**
+ * Restore the song and any open clip from the end of events.log.
+ * @brief Runs in setup() before BLE starts; cost is bounded by EVENTS_TAIL_BYTES.
+ */
+static void recover_session() {
+  LogTail tail;
+  bool found = recover_log_tail(&tail);
+  songtime_begin();  // lines written from here on belong to this boot
+  if (!found || !g_sync.recover(tail)) return;
+
+  goproQueryRecording();
+  g_recovery_deadline = millis() + RECOVERY_TIMEOUT_MS;
+}
+
+/**
+ * Resolve a restored clip once the camera answers (or the wait times out).
+ */
+static void recovery_tick() {
+  if (!g_sync.recovering()) return;
+
+  int rec = goproCameraRecording();
+  if (rec >= 0) {
+    g_sync.finish_recovery(rec == 1);
+  } else if ((int32_t)(millis() - g_recovery_deadline) >= 0) {
+    Serial.println("[RECOVER] camera status unavailable");
+    g_sync.finish_recovery(false);
   }
 }
 
 /*
-  ARDUINO ENTRY POINTS
+  BOOT REPORT
 */
 /**
- * Initialize hardware: Serial, GoPro WiFi, LittleFS, and BLE.
- * @brief Sets up all subsystems and starts BLE advertising.
- *        Called once on startup.
+ * Send the boot profile as BOOT notifications.
+ * @brief "BOOT_ADV <ms>" then one "BOOT <phase> <start_ms> <dur_ms|-1>" per
+ *        phase (-1 while still running, e.g. a Wi-Fi join in progress).
  */
-void setup() {
-  Serial.begin(115200);
-  delay(200);
+static void ble_send_boot_report() {
+  if (!g_ble_tx || !g_ble_subscribed) return;
+
+  char buf[64];
+  snprintf(buf, sizeof(buf), "BOOT_ADV %u", (unsigned)(boot_advertise_us() / 1000));
+  ble_notify_line(buf);
 
-  bool ok = goproBegin("GP26354747", "scuba0828");
-  Serial.println(ok ? "[GoPro] WiFi connected" : "[GoPro] WiFi connect FAILED");
+  for (int i = 0; i < boot_phase_count(); i++) {
+    const BootPhase& p = boot_phase(i);
+    delay(20);
+    snprintf(buf, sizeof(buf), "BOOT %s %u %d", p.name, (unsigned)(p.startUs / 1000),
+             p.endUs ? (int)((p.endUs - p.startUs) / 1000) : -1);
+    ble_notify_line(buf);
+  }
+}
 
+/*
+  ARDUINO ENTRY POINTS
+*/
+/**
+ * Mount LittleFS, formatting it if the mount fails.
+ */
+static void fs_begin() {
   if (!LittleFS.begin(false)) {
     Serial.println("[FS] LittleFS mount failed. Formatting...");
     if (!LittleFS.begin(true)) {
@@ -444,7 +669,25 @@ void setup() {
   } else {
     Serial.println("[FS] LittleFS mounted.");
   }
+}
 
+/**
+ * Stamp the event log with this board's ID: the NIC half of its factory MAC,
+ * so rigs stay distinguishable when their logs are merged.
+ */
+static void device_id_begin() {
+  uint64_t mac = ESP.getEfuseMac();
+  char id[8];
+  snprintf(id, sizeof(id), "%02x%02x%02x", (unsigned)((mac >> 24) & 0xFF),
+           (unsigned)((mac >> 32) & 0xFF), (unsigned)((mac >> 40) & 0xFF));
+  event_log_set_device(id);
+  Serial.printf("[LOG] device %s\n", id);
+}
+
+/**
+ * Create the NUS service and start advertising.
+ */
+static void ble_begin() {
   NimBLEDevice::init(BLE_NAME);
   NimBLEDevice::setPower(ESP_PWR_LVL_P9);
 
@@ -463,49 +706,95 @@ void setup() {
   );
   g_ble_tx->setCallbacks(new TxCallbacks());
 
+  status_begin(svc);
+
   svc->start();
 
   NimBLEAdvertising* adv = NimBLEDevice::getAdvertising();
   adv->addServiceUUID(UUID_SVC);
   adv->start();
+}
+
+/**
+ * Initialize hardware in stages: LittleFS, log-tail recovery, BLE advertising,
+ * then GoPro WiFi.
+ * @brief The phone can find "MusicSync" as soon as BLE is up; the camera join
+ *        runs concurrently on the supervisor task and shutter commands queue
+ *        until it is ready. Each phase is timed (see 'b').
+ *        Called once on startup.
+ */
+void setup() {
+  int ph = boot_phase_begin("serial");
+  Serial.begin(CONSOLE_BAUD);
+  console_begin();
+  boot_phase_end(ph);
+
+  g_sync.begin(SYNC_HOOKS);
+
+  ph = boot_phase_begin("fs");
+  fs_begin();
+  device_id_begin();
+  boot_phase_end(ph);
+
+  ph = boot_phase_begin("recover");
+  recover_session();
+  boot_phase_end(ph);
+
+  ph = boot_phase_begin("ble");
+  ble_begin();
+  boot_phase_end(ph);
+  boot_mark_advertising();
+
+  goproBegin("GP26354747", "scuba0828");
 
   Serial.println("\n--- ready ---");
-  Serial.println("Commands from phone: digits(timeMs), muri/title/dur, p1/p0, x(export xml)");
+  Serial.println("Commands from phone: digits(timeMs), muri/title/dur, p1/p0, x [fmt](export), r[t|f|s] [offset] [len], b(boot profile)");
+  boot_report(Serial);
 }
 
 /**
  * Main event loop: process serial/BLE commands and deferred operations.
  * @brief Continuously polls for commands and executes deferred GoPro/XML operations.
- *        Runs in main task context with sufficient stack for HTTP requests.
+ *        Camera HTTP runs on the Wi-Fi supervisor task, so this never blocks on it.
  */
 void loop() {
   serial_poll();
+  ble_inbox_poll();
 
-  // Whole song auto record
-  whole_song_tick();
+  // Whole song auto record + deferred GoPro start/stop
+  recovery_tick();
+  g_sync.tick();
+  g_sync.service_camera();
 
-  // GoPro start
-  if (g_gopro_start_pending) {
-    g_gopro_start_pending = false;
-    bool ok = goproShutter(true);
-    Serial.println(ok ? "[GoPro] rec START ok" : "[GoPro] rec START FAIL");
-  }
+  // Live status notifications
+  status_tick();
 
-  // GoPro stop
-  if (g_gopro_stop_pending) {
-    g_gopro_stop_pending = false;
-    bool ok = goproShutter(false);
-    Serial.println(ok ? "[GoPro] rec STOP ok" : "[GoPro] rec STOP FAIL");
-  }
+  // Trace capture
+  trace_flush();
+  songtime_tick(g_sync.recording());
 
   // XML send
   if (g_ble_send_xml_pending) {
     g_ble_send_xml_pending = false;
-    String xml = read_project_xml();
-    Serial.println(xml); // optional
-    ble_send_xml_chunks(xml);
+    ble_send_xml_chunks(g_ble_send_xml_path);
     Serial.println("[BLE] XML sent");
   }
 
+  // Boot profile query
+  if (g_ble_send_boot_pending) {
+    g_ble_send_boot_pending = false;
+    ble_send_boot_report();
+  }
+
+  // Ranged log page
+  if (g_log_req.pending) {
+    g_log_req.pending = false;
+    size_t next = send_log_range(g_log_req.toBle, g_log_req.offset, g_log_req.len);
+    Serial.printf("[BLE] log page sent, next=%u\n", (unsigned)next);
+  }
+
+  // Live-tail
+  log_follow_tick();
+
   delay(1);
 }
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include "offload.h"
+#include <LittleFS.h>
+
+#include "console.h"
+#include "crc32.h"
+#include "offload_frame.h"
+#include "xml_export.h"
+
+static const uint32_t BAUD_SWITCH_MS = 100;  // host reopens its port at the new rate
+
+static OffloadEncoder* g_enc = nullptr;
+static uint8_t g_block[OFFLOAD_BLOCK];
+
+/**
+ * Frame writer: raw bytes straight to the UART (blocks when the TX FIFO is full).
+ */
+static void uart_write(const uint8_t* data, size_t len, void* ctx) {
+  (void)ctx;
+  Serial.write(data, len);
+}
+
+/**
+ * Collect the files to send.
+ * @param out Receives names ("/events.log") and sizes
+ * @param only One path to send, or nullptr for every regular file
+ * @return Number of files (at most OFFLOAD_MAX_FILES)
+ * @brief A name that doesn't fit OFFLOAD_NAME_MAX with its '/' prefix is
+ *        skipped (and reported) rather than sent truncated.
+ */
+static int list_files(OffloadEntry* out, const char* only) {
+  int n = 0;
+  if (only) {
+    if (strlen(only) >= OFFLOAD_NAME_MAX) {
+      Serial.printf("[OFFLOAD] %s: name too long, not sent\n", only);
+      return 0;
+    }
+    File f = LittleFS.open(only, "r");
+    if (!f || f.isDirectory()) return 0;
+    strcpy(out[0].name, only);
+    out[0].size = f.size();
+    f.close();
+    return 1;
+  }
+
+  File root = LittleFS.open("/");
+  if (!root) return 0;
+  for (File f = root.openNextFile(); f && n < OFFLOAD_MAX_FILES; f = root.openNextFile()) {
+    if (f.isDirectory()) continue;
+    const char* name = f.name();
+    const char* slash = name[0] == '/' ? "" : "/";
+    if (strlen(slash) + strlen(name) >= OFFLOAD_NAME_MAX) {
+      Serial.printf("[OFFLOAD] %s%s: name too long, not sent\n", slash, name);
+      continue;
+    }
+    snprintf(out[n].name, OFFLOAD_NAME_MAX, "%s%s", slash, name);
+    out[n].size = f.size();
+    n++;
+  }
+  root.close();
+  return n;
+}
+
+/**
+ * Stream one file as FILE, DATA x N, FILE_END.
+ * @param index Index in the manifest
+ * @param e Name and size from the manifest
+ * @return Bytes sent
+ */
+static uint32_t send_file(uint16_t index, const OffloadEntry& e) {
+  File f = LittleFS.open(e.name, "r");
+  g_enc->file(index, f ? e.size : 0, e.name);
+
+  uint32_t off = 0;
+  uint32_t crc = 0;
+  while (f && off < e.size) {
+    size_t got = f.read(g_block, min((size_t)(e.size - off), sizeof(g_block)));
+    if (got == 0) break;
+    g_enc->data(index, off, g_block, got);
+    crc = crc32_update(crc, g_block, got);
+    off += got;
+  }
+  if (f) f.close();
+
+  g_enc->file_end(index, crc);
+  return off;
+}
+
+/**
+ * Run one offload session.
+ * @param baud UART rate for the transfer (921600 and up on the usual bridges)
+ * @param only One file path, or nullptr for all files
+ * @brief The manifest lists every file up front; each file carries its own
+ *        CRC-32 so the host can re-request just the ones that failed. Other
+ *        tasks' console output is muted from the announcement until the UART
+ *        is back at the console rate.
+ */
+void offload_run(uint32_t baud, const char* only) {
+  if (!only) export_project();
+
+  static OffloadEntry files[OFFLOAD_MAX_FILES];
+  int count = list_files(files, only);
+
+  console_quiet(true);
+  Serial.printf("OFFLOAD %lu %d\n", (unsigned long)baud, count);
+  Serial.flush();
+  delay(BAUD_SWITCH_MS);
+  Serial.updateBaudRate(baud);
+  delay(BAUD_SWITCH_MS);
+
+  static OffloadEncoder enc(uart_write, nullptr);
+  g_enc = &enc;
+  uint32_t t0 = millis();
+  uint32_t total = 0;
+
+  enc.sync();
+  enc.manifest(files, count);
+  for (int i = 0; i < count; i++) total += send_file((uint16_t)i, files[i]);
+  enc.done((uint16_t)count, total);
+
+  Serial.flush();
+  uint32_t ms = millis() - t0;
+  delay(BAUD_SWITCH_MS);
+  Serial.updateBaudRate(CONSOLE_BAUD);
+  console_quiet(false);
+
+  Serial.printf("[OFFLOAD] %d files, %lu bytes in %lu ms (%lu KB/s)\n", count,
+                (unsigned long)total, (unsigned long)ms,
+                (unsigned long)(ms ? total / ms : 0));
+}
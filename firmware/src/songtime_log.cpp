@@ -0,0 +1,161 @@
+#include "songtime_log.h"
+#include <LittleFS.h>
+
+static const char* SONGTIME_PATH = "/songtime.bin";
+static const size_t SONGTIME_MARKER_SLACK = 4096;  // boot markers still fit past the cap
+
+static uint32_t g_songtime_boot = 0;   // events.log seq this boot started after
+static size_t g_songtime_size = 0;     // cached file size
+static uint32_t g_songtime_dropped = 0;
+
+// Samples are added from the BLE task and drained from loop().
+static portMUX_TYPE g_songtime_mux = portMUX_INITIALIZER_UNLOCKED;
+static SongTimeStore g_songtime_store;
+
+/**
+ * Append queued blocks to /songtime.bin.
+ * @brief One write per finished block (at most 30 s of updates while
+ *        recording), nothing at all while idle. Once the file reaches
+ *        SONGTIME_MAX_BYTES only boot markers are written, so the
+ *        boot-to-log mapping stays intact.
+ */
+static void write_ready() {
+  static uint8_t out[2 * SONGTIME_BLOCK_MAX + SONGTIME_HEADER_BYTES];
+  size_t n;
+
+  portENTER_CRITICAL(&g_songtime_mux);
+  n = g_songtime_store.take(out, sizeof(out));
+  portEXIT_CRITICAL(&g_songtime_mux);
+  if (!n) return;
+
+  size_t cap = n > SONGTIME_HEADER_BYTES ? SONGTIME_MAX_BYTES
+                                         : SONGTIME_MAX_BYTES + SONGTIME_MARKER_SLACK;
+  if (g_songtime_size + n > cap) {
+    g_songtime_dropped += n;
+    return;
+  }
+
+  File f = LittleFS.open(SONGTIME_PATH, "a");
+  if (!f) return;
+  g_songtime_size += f.write(out, n);
+  f.close();
+}
+
+/**
+ * Start this boot's trace.
+ * @brief Called after recover_log_tail() so the boot marker carries the seq
+ *        of the last line before this boot; every later line is newer.
+ */
+void songtime_begin() {
+  g_songtime_boot = event_log_seq();
+  g_songtime_size = file_size(SONGTIME_PATH);
+  portENTER_CRITICAL(&g_songtime_mux);
+  g_songtime_store.begin(g_songtime_boot);
+  portEXIT_CRITICAL(&g_songtime_mux);
+  write_ready();
+}
+
+/**
+ * Record one song-time update with its arrival time.
+ * @param songMs Song time the phone sent
+ * @brief Only encodes into RAM; safe to call from the BLE task.
+ */
+void songtime_record(uint32_t songMs) {
+  uint32_t now = millis();
+  portENTER_CRITICAL(&g_songtime_mux);
+  g_songtime_store.add(now, songMs);
+  portEXIT_CRITICAL(&g_songtime_mux);
+}
+
+/**
+ * Main-loop hook.
+ * @param recording A clip is open, so the block being filled must be kept
+ */
+void songtime_tick(bool recording) {
+  if (recording) {
+    portENTER_CRITICAL(&g_songtime_mux);
+    g_songtime_store.mark_keep();
+    portEXIT_CRITICAL(&g_songtime_mux);
+  }
+  write_ready();
+}
+
+/**
+ * Close the open block so readers see the latest samples.
+ */
+void songtime_flush() {
+  portENTER_CRITICAL(&g_songtime_mux);
+  g_songtime_store.flush();
+  portEXIT_CRITICAL(&g_songtime_mux);
+  write_ready();
+}
+
+/**
+ * Delete /songtime.bin and restart it with this boot's marker.
+ */
+void songtime_clear() {
+  LittleFS.remove(SONGTIME_PATH);
+  g_songtime_dropped = 0;
+  songtime_begin();
+}
+
+uint32_t songtime_dropped() {
+  return g_songtime_dropped + g_songtime_store.bytes_dropped();
+}
+
+/**
+ * Refine clip boundaries and add discontinuity marks from the trace.
+ * @param tl Timeline parsed from events.log, updated in place
+ * @param stats Receives counters
+ * @return false if /songtime.bin is missing or empty
+ * @brief Hops from block header to block header (22-byte reads) and only
+ *        reads the payload of blocks near a clip, so cost follows the
+ *        recorded clips rather than the file size.
+ */
+bool songtime_refine(Timeline* tl, SongTimeRefineStats* stats) {
+  songtime_flush();
+  memset(stats, 0, sizeof(*stats));
+
+  File f = LittleFS.open(SONGTIME_PATH, "r");
+  if (!f) return false;
+  size_t size = f.size();
+
+  static uint8_t block[SONGTIME_BLOCK_MAX];
+  static SongTimeRefiner refiner;
+  refiner.begin(tl);
+  SongTimeBlock b;
+  // A block torn by a reset mid-append ends the file
+  for (int pass = 0; pass < 2; pass++) {
+    for (size_t off = 0; off + SONGTIME_HEADER_BYTES <= size; ) {
+      f.seek(off);
+      if (f.read(block, SONGTIME_HEADER_BYTES) != SONGTIME_HEADER_BYTES) break;
+      if (!songtime_parse_header(block, SONGTIME_HEADER_BYTES, &b)) break;
+      size_t len = SONGTIME_HEADER_BYTES + b.payloadBytes;
+      if (off + len > size) break;
+
+      if (!pass) {
+        refiner.header(b);
+      } else if (refiner.want(b)) {
+        if (f.read(block + SONGTIME_HEADER_BYTES, b.payloadBytes) != b.payloadBytes) break;
+        refiner.block(block, len);
+      }
+      off += len;
+    }
+  }
+  f.close();
+
+  refiner.finish(stats);
+  return size > 0;
+}
+
+size_t songtime_size() {
+  return file_size(SONGTIME_PATH);
+}
+
+/**
+ * Stream a byte range of /songtime.bin to a sink.
+ * @return Continuation offset
+ */
+size_t read_songtime_range(size_t offset, size_t len, ChunkSink sink, void* ctx) {
+  return read_file_range(SONGTIME_PATH, offset, len, sink, ctx);
+}
@@ -0,0 +1,262 @@
+#include "status_channel.h"
+#include <LittleFS.h>
+#include <stdarg.h>
+
+#include "app_state.h"
+#include "console.h"
+#include "go_pro.h"
+
+static const char* UUID_STATUS = "6E400004-B5A3-F393-E0A9-E50E24DCCA9E";  // notify + read
+
+static const uint32_t STATUS_MIN_INTERVAL_MS = 500;     // leave airtime for the time stream
+static const uint32_t STATUS_FULL_INTERVAL_MS = 30000;  // periodic resync snapshot
+static const uint32_t STATUS_FS_POLL_MS = 5000;         // usedBytes() walks the FS
+static const uint32_t STATUS_READ_REFRESH_MS = 100;     // age of the snapshot reads get
+static const uint32_t STATUS_TIME_DRIFT_MS = 500;       // resend t on seek/stall
+static const uint16_t STATUS_HEAP_STEP_KB = 4;          // ignore allocator noise
+
+/**
+ * Everything the phone can see, in comparable form.
+ */
+struct StatusSnapshot {
+  bool play;
+  bool rec;
+  bool hold;
+  char clip[64];
+  uint32_t t;
+  uint8_t link;
+  uint32_t shutSeq;
+  bool shutOn;
+  bool shutOk;
+  uint16_t fsUsedKb;
+  uint16_t fsTotalKb;
+  uint16_t heapKb;
+  uint32_t metaSuppressed;
+};
+
+// Fields written by status_encode(), as a bit mask
+enum StatusField {
+  SF_PLAY = 1 << 0,
+  SF_REC  = 1 << 1,
+  SF_HOLD = 1 << 2,
+  SF_CLIP = 1 << 3,
+  SF_T    = 1 << 4,
+  SF_LINK = 1 << 5,
+  SF_SHUT = 1 << 6,
+  SF_FS   = 1 << 7,
+  SF_SUP  = 1 << 8,
+  SF_HEAP = 1 << 9,
+};
+
+static NimBLECharacteristic* g_status_chr = nullptr;
+static volatile bool g_status_subscribed = false;
+static volatile bool g_status_full_pending = false;
+
+static StatusSnapshot g_sent = {};    // state as last notified
+static uint32_t g_sent_t_at = 0;      // millis() when g_sent.t was sent
+static uint32_t g_last_notify = 0;
+static uint32_t g_last_full = 0;
+static uint32_t g_fs_polled = 0;
+static uint16_t g_fs_used_kb = 0;
+static uint16_t g_fs_total_kb = 0;
+static uint32_t g_seq = 0;
+
+// Latest sample for reads: built on loop(), copied out on the BLE task
+static portMUX_TYPE g_read_mux = portMUX_INITIALIZER_UNLOCKED;
+static StatusSnapshot g_read = {};
+static uint32_t g_read_at = 0;          // millis() when g_read was sampled
+
+/**
+ * Capture the current state.
+ * @param s Output snapshot
+ * @brief Reads loop-owned state and the file system: main loop only.
+ */
+static void status_sample(StatusSnapshot* s) {
+  uint32_t now = millis();
+  if (g_fs_polled == 0 || now - g_fs_polled >= STATUS_FS_POLL_MS) {
+    g_fs_polled = now;
+    g_fs_used_kb = (uint16_t)(LittleFS.usedBytes() / 1024);
+    g_fs_total_kb = (uint16_t)(LittleFS.totalBytes() / 1024);
+  }
+
+  const GoproLinkStats& ls = goproLinkStats();
+  s->play = g_sync.playing();
+  s->rec = g_sync.recording();
+  s->hold = g_sync.holding();
+  strncpy(s->clip, g_sync.recording() ? g_sync.clip_file() : "", sizeof(s->clip) - 1);
+  s->clip[sizeof(s->clip) - 1] = '\0';
+  s->t = g_sync.interpolated_time();
+  s->link = (uint8_t)goproLinkState();
+  s->shutSeq = ls.shutterSent;
+  s->shutOn = ls.lastShutterOn;
+  s->shutOk = ls.lastShutterOk;
+  s->fsUsedKb = g_fs_used_kb;
+  s->fsTotalKb = g_fs_total_kb;
+  s->heapKb = (uint16_t)(ESP.getFreeHeap() / 1024);
+  s->metaSuppressed = g_sync.stats().metaDuplicate + g_sync.stats().metaStale;
+}
+
+/**
+ * Append "key=value;" to a message buffer.
+ */
+static void put_field(char* out, size_t cap, size_t* len, const char* fmt, ...) {
+  if (*len >= cap) return;
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(out + *len, cap - *len, fmt, ap);
+  va_end(ap);
+  if (n > 0) *len = min(*len + (size_t)n, cap - 1);
+}
+
+/**
+ * Encode a snapshot, either in full or as a delta against the last one sent.
+ * @param out Output buffer
+ * @param cap Size of output buffer
+ * @param cur Current state
+ * @param prev Last notified state, or nullptr for a full snapshot
+ * @return StatusField bits of the fields written (0 means nothing changed)
+ */
+static uint16_t status_encode(char* out, size_t cap, const StatusSnapshot& cur,
+                              const StatusSnapshot* prev) {
+  size_t len = 0;
+  uint16_t fields = 0;
+  out[0] = '\0';
+
+  if (!prev || cur.play != prev->play) {
+    put_field(out, cap, &len, "play=%d;", cur.play ? 1 : 0); fields |= SF_PLAY;
+  }
+  if (!prev || cur.rec != prev->rec) {
+    put_field(out, cap, &len, "rec=%d;", cur.rec ? 1 : 0); fields |= SF_REC;
+  }
+  if (!prev || cur.hold != prev->hold) {
+    put_field(out, cap, &len, "hold=%d;", cur.hold ? 1 : 0); fields |= SF_HOLD;
+  }
+  if (!prev || strcmp(cur.clip, prev->clip) != 0) {
+    put_field(out, cap, &len, "clip=%s;", cur.clip); fields |= SF_CLIP;
+  }
+
+  // Song time is predicted from the last value sent; only a seek, stall or
+  // play-state change is worth airtime.
+  uint32_t predicted = prev ? prev->t + (prev->play ? millis() - g_sent_t_at : 0) : 0;
+  int32_t drift = (int32_t)(cur.t - predicted);
+  if (!prev || cur.play != prev->play || abs(drift) > (int32_t)STATUS_TIME_DRIFT_MS) {
+    put_field(out, cap, &len, "t=%lu;", (unsigned long)cur.t); fields |= SF_T;
+  }
+
+  if (!prev || cur.link != prev->link) {
+    put_field(out, cap, &len, "link=%s;", goproLinkName((GoproLink)cur.link));
+    fields |= SF_LINK;
+  }
+  if (!prev || cur.shutSeq != prev->shutSeq) {
+    put_field(out, cap, &len, "shut=%lu:%s:%s;", (unsigned long)cur.shutSeq,
+              cur.shutOn ? "start" : "stop", cur.shutOk ? "ok" : "fail");
+    fields |= SF_SHUT;
+  }
+  if (!prev || cur.fsUsedKb != prev->fsUsedKb || cur.fsTotalKb != prev->fsTotalKb) {
+    put_field(out, cap, &len, "fs=%u/%u;", cur.fsUsedKb, cur.fsTotalKb); fields |= SF_FS;
+  }
+  if (!prev || cur.metaSuppressed != prev->metaSuppressed) {
+    put_field(out, cap, &len, "sup=%lu;", (unsigned long)cur.metaSuppressed); fields |= SF_SUP;
+  }
+  if (!prev || abs((int)cur.heapKb - (int)prev->heapKb) >= STATUS_HEAP_STEP_KB) {
+    put_field(out, cap, &len, "heap=%u;", cur.heapKb); fields |= SF_HEAP;
+  }
+
+  if (len && out[len - 1] == ';') out[len - 1] = '\0';
+  return fields;
+}
+
+/**
+ * Status characteristic callbacks.
+ * @brief Subscribing triggers a full snapshot; a read always returns one.
+ *        Both run on the BLE task, so a read encodes the last snapshot
+ *        status_tick() took on loop() (with t advanced to now) instead of
+ *        sampling the sync engine and LittleFS itself.
+ */
+class StatusCallbacks : public NimBLECharacteristicCallbacks {
+  void onSubscribe(NimBLECharacteristic* chr, ble_gap_conn_desc* desc, uint16_t subValue) override {
+    (void)chr; (void)desc;
+    g_status_subscribed = (subValue & 0x0001) != 0;
+    g_status_full_pending = g_status_subscribed;
+    console_printf("[BLE] status subscribed=%d\n", g_status_subscribed ? 1 : 0);
+  }
+
+  void onRead(NimBLECharacteristic* chr) override {
+    StatusSnapshot cur;
+    uint32_t at;
+    portENTER_CRITICAL(&g_read_mux);
+    cur = g_read;
+    at = g_read_at;
+    portEXIT_CRITICAL(&g_read_mux);
+    if (cur.play) cur.t += millis() - at;
+
+    char body[200];
+    status_encode(body, sizeof(body), cur, nullptr);
+    char msg[216];
+    snprintf(msg, sizeof(msg), "F%lu %s", (unsigned long)g_seq, body);
+    chr->setValue((uint8_t*)msg, strlen(msg));
+  }
+};
+
+/**
+ * Create the status characteristic on the NUS service.
+ * @param svc Service to attach to (before svc->start())
+ */
+void status_begin(NimBLEService* svc) {
+  g_status_chr = svc->createCharacteristic(
+    UUID_STATUS,
+    NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::NOTIFY
+  );
+  g_status_chr->setCallbacks(new StatusCallbacks());
+}
+
+/**
+ * Sample state and notify coalesced changes; call from loop().
+ * @brief At most one notification per STATUS_MIN_INTERVAL_MS carrying every
+ *        field that changed since the last one, so bursts of changes (track
+ *        change = rec, clip, t, shut) cost one packet. The sample is also
+ *        kept for reads, refreshed every STATUS_READ_REFRESH_MS.
+ */
+void status_tick() {
+  if (!g_status_chr) return;
+
+  uint32_t now = millis();
+  bool notifyDue = g_status_subscribed && now - g_last_notify >= STATUS_MIN_INTERVAL_MS;
+  bool readDue = g_read_at == 0 || now - g_read_at >= STATUS_READ_REFRESH_MS;
+  if (!notifyDue && !readDue) return;
+
+  StatusSnapshot cur;
+  status_sample(&cur);
+  portENTER_CRITICAL(&g_read_mux);
+  g_read = cur;
+  g_read_at = now;
+  portEXIT_CRITICAL(&g_read_mux);
+  if (!notifyDue) return;
+
+  bool full = g_status_full_pending || now - g_last_full >= STATUS_FULL_INTERVAL_MS;
+
+  char body[200];
+  uint16_t fields = status_encode(body, sizeof(body), cur, full ? nullptr : &g_sent);
+  if (!fields) return;
+
+  char msg[216];
+  int n = snprintf(msg, sizeof(msg), "%c%lu %s", full ? 'F' : 'S',
+                   (unsigned long)++g_seq, body);
+  g_status_chr->setValue((uint8_t*)msg, min((size_t)n, sizeof(msg) - 1));
+  g_status_chr->notify();
+
+  // Fields not sent keep their old baseline so slow drifts still surface.
+  if (fields & SF_T) { g_sent.t = cur.t; g_sent_t_at = now; }
+  if (fields & SF_HEAP) g_sent.heapKb = cur.heapKb;
+  uint32_t t = g_sent.t;
+  uint16_t heap = g_sent.heapKb;
+  g_sent = cur;
+  g_sent.t = t;
+  g_sent.heapKb = heap;
+
+  g_last_notify = now;
+  if (full) {
+    g_last_full = now;
+    g_status_full_pending = false;
+  }
+}
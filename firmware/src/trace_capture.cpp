@@ -0,0 +1,118 @@
+#include "trace_capture.h"
+#include <LittleFS.h>
+
+static const char* TRACE_PATH = "/trace.log";
+static const size_t TRACE_BUF = 1024;  // flushed when half full or every second
+static const uint32_t TRACE_FLUSH_MS = 1000;
+
+static volatile bool g_trace_on = false;
+static volatile uint32_t g_trace_dropped = 0;
+static uint32_t g_trace_last_flush = 0;
+
+// Records are appended from the BLE task and drained from loop().
+static portMUX_TYPE g_trace_mux = portMUX_INITIALIZER_UNLOCKED;
+static char g_trace_buf[TRACE_BUF];
+static size_t g_trace_fill = 0;
+
+/**
+ * Start capturing inbound messages.
+ * @brief Truncates /trace.log so each capture is a self-contained session.
+ */
+void trace_start() {
+  portENTER_CRITICAL(&g_trace_mux);
+  g_trace_fill = 0;
+  portEXIT_CRITICAL(&g_trace_mux);
+
+  File f = LittleFS.open(TRACE_PATH, "w");
+  if (f) f.close();
+
+  g_trace_dropped = 0;
+  g_trace_last_flush = millis();
+  g_trace_on = true;
+}
+
+/**
+ * Stop capturing and write any buffered records.
+ */
+void trace_stop() {
+  g_trace_on = false;
+  trace_flush();
+}
+
+bool trace_active() {
+  return g_trace_on;
+}
+
+uint32_t trace_dropped() {
+  return g_trace_dropped;
+}
+
+/**
+ * Record one inbound message with its arrival time.
+ * @param source 'B' for BLE, 'S' for serial
+ * @param data Raw message bytes (CR/LF are replaced with spaces)
+ * @param len Number of bytes
+ * @brief Only copies into RAM; safe to call from the BLE task. Records that
+ *        don't fit before the next flush are dropped and counted.
+ */
+void trace_record(char source, const uint8_t* data, size_t len) {
+  if (!g_trace_on) return;
+
+  char head[16];
+  int h = snprintf(head, sizeof(head), "%lu %c ", (unsigned long)millis(), source);
+  if (len > 255) len = 255;
+
+  portENTER_CRITICAL(&g_trace_mux);
+  if (g_trace_fill + h + len + 1 > sizeof(g_trace_buf)) {
+    g_trace_dropped++;
+  } else {
+    memcpy(g_trace_buf + g_trace_fill, head, h);
+    g_trace_fill += h;
+    for (size_t i = 0; i < len; i++) {
+      char c = (char)data[i];
+      g_trace_buf[g_trace_fill++] = (c == '\r' || c == '\n') ? ' ' : c;
+    }
+    g_trace_buf[g_trace_fill++] = '\n';
+  }
+  portEXIT_CRITICAL(&g_trace_mux);
+}
+
+/**
+ * Append buffered trace records to /trace.log.
+ * @brief Called from loop(); writes once the buffer is half full or
+ *        TRACE_FLUSH_MS has passed, so the 150 ms time stream costs one
+ *        flash write per second rather than one per message.
+ */
+void trace_flush() {
+  static char out[TRACE_BUF];
+  size_t n;
+
+  portENTER_CRITICAL(&g_trace_mux);
+  bool due = g_trace_fill >= TRACE_BUF / 2 || !g_trace_on ||
+             millis() - g_trace_last_flush >= TRACE_FLUSH_MS;
+  n = due ? g_trace_fill : 0;
+  if (n) memcpy(out, g_trace_buf, n);
+  if (due) g_trace_fill = 0;
+  portEXIT_CRITICAL(&g_trace_mux);
+
+  if (!due) return;
+  g_trace_last_flush = millis();
+  if (!n) return;
+
+  File f = LittleFS.open(TRACE_PATH, "a");
+  if (!f) return;
+  f.write((const uint8_t*)out, n);
+  f.close();
+}
+
+size_t trace_size() {
+  return file_size(TRACE_PATH);
+}
+
+/**
+ * Stream a byte range of /trace.log to a sink.
+ * @return Continuation offset
+ */
+size_t read_trace_range(size_t offset, size_t len, ChunkSink sink, void* ctx) {
+  return read_file_range(TRACE_PATH, offset, len, sink, ctx);
+}
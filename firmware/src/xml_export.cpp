@@ -1,107 +1,176 @@
 #include "xml_export.h"
 #include <LittleFS.h>
 
+#include "songtime_log.h"
+#include "timeline.h"
+#include "timeline_writers.h"
+
 static const char* XML_PATH = "/project.xml";
 
+// GoPro "30 fps" modes actually record at 29.97 NDF.
+static const FrameRate EXPORT_RATE = FPS_29_97;
+
+/*
+  BUFFERED FILE SINK
+*/
 /**
- * Parse events.log and generate Final Cut Pro compatible XML timeline.
- * @param eventsText Contents of events.log file
- * @return true if XML file was successfully written, false if file open failed
- * @brief Parses SONG and CLIP_START/CLIP_END events, generates /project.xml
- *        with synchronized video clips mapped to song timeline.
- *        Supports up to 32 clips per session.
+ * TimelineSink that batches small writer puts into block writes.
+ * @brief LittleFS cost is per write call, so writers' many tiny puts are
+ *        collected into FS_READ_BLOCK-sized writes.
  */
-bool export_xml_from_events(const String& eventsText) {
-  // Minimal parser: one SONG, and CLIP_START/CLIP_END pairs.
-  String songUri = "", songTitle = "";
-  uint32_t songDur = 0;
-
-  /**
-   * Video clip with timeline sync points.
-   * @brief Stores filename and start/end times relative to song playback.
-   */
-  struct Clip { 
-    String file; 
-    uint32_t a, b;
-    Clip() : a(0), b(0) {}
-    Clip(String f, uint32_t start, uint32_t end) : file(f), a(start), b(end) {}
-  };
-  Clip clips[32];
-  int clipCount = 0;
-
-  String curFile = "";
-  uint32_t curStart = 0;
-
-  int i = 0;
-  while (i < (int)eventsText.length()) {
-    int j = eventsText.indexOf('\n', i);
-    if (j < 0) j = eventsText.length();
-    String line = eventsText.substring(i, j);
-    line.trim();
-    i = j + 1;
-    if (!line.length()) continue;
-
-    if (line.startsWith("SONG ")) {
-      int u = line.indexOf("uri=\"");
-      int t = line.indexOf("title=\"");
-      int d = line.indexOf("durationMs=");
-
-      if (u >= 0) { int e = line.indexOf("\"", u+5); songUri = line.substring(u+5, e); }
-      if (t >= 0) { int e = line.indexOf("\"", t+7); songTitle = line.substring(t+7, e); }
-      if (d >= 0) { songDur = (uint32_t)line.substring(d+11).toInt(); }
-    }
+class BufferedFileSink : public TimelineSink {
+ public:
+  BufferedFileSink() : fill_(0), bytes_(0), ok_(true) {}
+
+  bool open(const char* path) {
+    f_ = LittleFS.open(path, "w");
+    fill_ = 0;
+    bytes_ = 0;
+    ok_ = (bool)f_;
+    return ok_;
+  }
 
-    if (line.startsWith("CLIP_START")) {
-      int f = line.indexOf("file=\"");
-      int s = line.indexOf("songMs=");
-      if (f >= 0) { int e = line.indexOf("\"", f+6); curFile = line.substring(f+6, e); }
-      if (s >= 0) { curStart = (uint32_t)line.substring(s+7).toInt(); }
+  void write(const char* data, size_t len) override {
+    bytes_ += len;
+    while (len) {
+      size_t n = min(sizeof(buf_) - fill_, len);
+      memcpy(buf_ + fill_, data, n);
+      fill_ += n;
+      data += n;
+      len -= n;
+      if (fill_ == sizeof(buf_)) flush();
     }
+  }
+
+  bool close() {
+    flush();
+    if (f_) f_.close();
+    return ok_;
+  }
 
-    if (line.startsWith("CLIP_END")) {
-      int s = line.indexOf("songMs=");
-      uint32_t endMs = (s >= 0) ? (uint32_t)line.substring(s+7).toInt() : 0;
+  size_t bytes() const { return bytes_; }
 
-      if (clipCount < 32 && curFile.length()) {
-        clips[clipCount++] = Clip{curFile, curStart, endMs};
-      }
-      curFile = "";
-      curStart = 0;
-    }
+ private:
+  void flush() {
+    if (fill_ && f_ && f_.write((const uint8_t*)buf_, fill_) != fill_) ok_ = false;
+    fill_ = 0;
   }
 
-  File f = LittleFS.open(XML_PATH, "w");
-  if (!f) return false;
-
-  f.println("<?xml version=\"1.0\" encoding=\"UTF-8\"?>");
-  f.println("<Project name=\"Session1\">");
-  f.print("  <Song uri=\""); f.print(songUri);
-  f.print("\" title=\""); f.print(songTitle);
-  f.print("\" durationMs=\""); f.print(songDur);
-  f.println("\"/>");
-
-  for (int k = 0; k < clipCount; k++) {
-    f.print("  <Clip file=\""); f.print(clips[k].file);
-    f.print("\" startSongMs=\""); f.print(clips[k].a);
-    f.print("\" endSongMs=\""); f.print(clips[k].b);
-    f.println("\"/>");
+  File f_;
+  char buf_[FS_READ_BLOCK];
+  size_t fill_;
+  size_t bytes_;
+  bool ok_;
+};
+
+/*
+  EXPORT TARGETS
+*/
+static LegacyXmlWriter s_xml_writer;
+static FcpxmlWriter s_fcpxml_writer(EXPORT_RATE);
+static Cmx3600EdlWriter s_edl_writer(EXPORT_RATE);
+static OtioJsonWriter s_otio_writer(EXPORT_RATE);
+
+struct ExportTarget {
+  const char* path;
+  TimelineWriter* writer;
+};
+
+static const ExportTarget TARGETS[] = {
+  { XML_PATH,          &s_xml_writer },
+  { "/project.fcpxml", &s_fcpxml_writer },
+  { "/project.edl",    &s_edl_writer },
+  { "/project.otio",   &s_otio_writer },
+};
+static const int TARGET_COUNT = sizeof(TARGETS) / sizeof(TARGETS[0]);
+
+static BufferedFileSink s_sinks[TARGET_COUNT];
+static Timeline s_timeline;
+
+static uint32_t now_us() {
+  return (uint32_t)micros();
+}
+
+/**
+ * Resolve an export format name to its file path.
+ * @param format "xml", "fcpxml", "edl" or "otio" (NULL or "" means "xml")
+ * @return LittleFS path, or nullptr if the format is unknown
+ */
+const char* export_path(const char* format) {
+  if (!format || !*format) return XML_PATH;
+  for (int i = 0; i < TARGET_COUNT; i++)
+    if (strcmp(format, TARGETS[i].writer->name()) == 0) return TARGETS[i].path;
+  return nullptr;
+}
+
+/**
+ * Write every export format from an already-parsed timeline.
+ * @param tl Parsed timeline
+ * @return true if all files were written, false if any open/write failed
+ * @brief Runs all writers in a single pass over the clips, each into its own
+ *        buffered file, and prints per-format size and time to Serial.
+ */
+static bool export_timeline(const Timeline& tl) {
+  TimelineWriter* writers[TARGET_COUNT];
+  TimelineSink* sinks[TARGET_COUNT];
+  uint32_t elapsed[TARGET_COUNT];
+  bool ok = true;
+
+  for (int i = 0; i < TARGET_COUNT; i++) {
+    writers[i] = TARGETS[i].writer;
+    sinks[i] = &s_sinks[i];
+    if (!s_sinks[i].open(TARGETS[i].path)) ok = false;
+  }
+
+  timeline_emit(tl, writers, sinks, TARGET_COUNT, elapsed, now_us);
+
+  for (int i = 0; i < TARGET_COUNT; i++) {
+    uint32_t t0 = now_us();
+    if (!s_sinks[i].close()) ok = false;
+    elapsed[i] += now_us() - t0;
+    Serial.printf("[EXPORT] %-6s %6u B  %6.2f ms\n", writers[i]->name(),
+                  (unsigned)s_sinks[i].bytes(), elapsed[i] / 1000.0f);
   }
+  return ok;
+}
+
+/**
+ * ChunkSink adapter: feed LittleFS blocks into the timeline parser.
+ */
+static void parser_sink(const uint8_t* data, size_t len, void* ctx) {
+  ((TimelineParser*)ctx)->feed((const char*)data, len);
+}
 
-  f.println("</Project>");
-  f.close();
-  return true;
+/**
+ * Apply /songtime.bin to a freshly parsed timeline.
+ * @param tl Timeline to refine in place
+ * @brief Prints what changed; a missing trace leaves the timeline as logged.
+ */
+static void refine_timeline(Timeline* tl) {
+  uint32_t t0 = now_us();
+  SongTimeRefineStats st;
+  if (!songtime_refine(tl, &st)) return;
+  Serial.printf("[EXPORT] songtime %6u B  %6.2f ms  (%d/%d blocks, %d refined, max %u ms, %d marks)\n",
+                (unsigned)songtime_size(), (now_us() - t0) / 1000.0f, st.blocksDecoded,
+                st.blocks, st.refined, (unsigned)st.maxShiftMs, st.marks);
 }
 
 /**
- * Read the generated project XML file.
- * @return Complete XML contents, or empty string if file doesn't exist
- * @brief Reads /project.xml for display or BLE transmission to client.
+ * Parse events.log and generate all timeline exports.
+ * @return true if every export file was written
+ * @brief Streams /events.log through the parser block by block (one parse),
+ *        refines it from /songtime.bin, then writes /project.xml, .fcpxml,
+ *        .edl and .otio in one pass. Supports up to TIMELINE_MAX_CLIPS clips
+ *        per session.
  */
-String read_project_xml() {
-  File f = LittleFS.open(XML_PATH, "r");
-  if (!f) return "";
-  String out;
-  while (f.available()) out += char(f.read());
-  f.close();
-  return out;
+bool export_project() {
+  uint32_t t0 = now_us();
+  TimelineParser parser(&s_timeline);
+  read_events_range(0, SIZE_MAX, parser_sink, &parser);
+  parser.finish();
+  Serial.printf("[EXPORT] parse  %6u B  %6.2f ms  (%d clips)\n",
+                (unsigned)events_size(), (now_us() - t0) / 1000.0f,
+                s_timeline.clipCount);
+  refine_timeline(&s_timeline);
+  return export_timeline(s_timeline);
 }
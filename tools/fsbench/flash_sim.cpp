@@ -0,0 +1,72 @@
+#include "flash_sim.h"
+#include <string.h>
+
+FlashSim::FlashSim(const FlashGeometry& geo, const FlashCosts& costs)
+    : geo_(geo), costs_(costs), mem_((size_t)geo.blockSize * geo.blockCount, 0xFF),
+      wear_(geo.blockCount, 0), clockUs_(0) {
+  memset(&cfg_, 0, sizeof(cfg_));
+  cfg_.context = this;
+  cfg_.read = read;
+  cfg_.prog = prog;
+  cfg_.erase = erase;
+  cfg_.sync = sync;
+  cfg_.read_size = geo.readSize;
+  cfg_.prog_size = geo.progSize;
+  cfg_.block_size = geo.blockSize;
+  cfg_.block_count = geo.blockCount;
+  cfg_.block_cycles = geo.blockCycles;
+  cfg_.cache_size = geo.cacheSize;
+  cfg_.lookahead_size = geo.lookaheadSize;
+}
+
+int FlashSim::read(const lfs_config* c, lfs_block_t block, lfs_off_t off, void* buffer,
+                   lfs_size_t size) {
+  FlashSim* f = (FlashSim*)c->context;
+  memcpy(buffer, &f->mem_[(size_t)block * f->geo_.blockSize + off], size);
+  f->ctr_.reads++;
+  f->ctr_.readBytes += size;
+  f->clockUs_ += f->costs_.opUs + (uint64_t)(size * f->costs_.readUsPerByte);
+  return 0;
+}
+
+/**
+ * Program bytes. NOR flash can only clear bits, so the result is AND-ed
+ * with what is there (a missing erase shows up as corruption, as on the chip).
+ */
+int FlashSim::prog(const lfs_config* c, lfs_block_t block, lfs_off_t off, const void* buffer,
+                   lfs_size_t size) {
+  FlashSim* f = (FlashSim*)c->context;
+  uint8_t* dst = &f->mem_[(size_t)block * f->geo_.blockSize + off];
+  const uint8_t* src = (const uint8_t*)buffer;
+  for (lfs_size_t i = 0; i < size; i++) dst[i] &= src[i];
+  f->ctr_.progs++;
+  f->ctr_.progBytes += size;
+  f->clockUs_ += f->costs_.opUs + (uint64_t)(size * f->costs_.progUsPerByte);
+  return 0;
+}
+
+int FlashSim::erase(const lfs_config* c, lfs_block_t block) {
+  FlashSim* f = (FlashSim*)c->context;
+  memset(&f->mem_[(size_t)block * f->geo_.blockSize], 0xFF, f->geo_.blockSize);
+  f->wear_[block]++;
+  f->ctr_.erases++;
+  f->clockUs_ += f->costs_.eraseUs;
+  return 0;
+}
+
+int FlashSim::sync(const lfs_config* c) {
+  (void)c;
+  return 0;
+}
+
+uint32_t FlashSim::max_block_erases() const {
+  uint32_t m = 0;
+  for (uint32_t w : wear_) m = w > m ? w : m;
+  return m;
+}
+
+double FlashSim::mean_block_erases() const {
+  uint64_t sum = 0;
+  for (uint32_t w : wear_) sum += w;
+  return wear_.empty() ? 0 : (double)sum / wear_.size();
+}
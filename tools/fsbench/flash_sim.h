@@ -0,0 +1,66 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "lfs.h"
+
+/*
+  RAM-backed NOR flash for littlefs with an ESP32-like cost model. Every
+  read/prog/erase advances a virtual clock instead of sleeping, so a run is
+  fast on the host but reports flash time the way the device would see it.
+*/
+struct FlashCosts {
+  uint32_t opUs = 20;          // SPI command + address overhead per call
+  double readUsPerByte = 0.1;  // ~10 MB/s (40 MHz DIO)
+  double progUsPerByte = 2.4;  // ~600 us per 256-byte page
+  uint32_t eraseUs = 45000;    // 4 KB sector erase (typ.; datasheet max ~400 ms)
+};
+
+struct FlashGeometry {
+  uint32_t blockSize = 4096;
+  uint32_t blockCount = 352;   // 1408 KB: the "spiffs" partition of default.csv
+  uint32_t readSize = 128;     // esp_littlefs defaults
+  uint32_t progSize = 128;
+  uint32_t cacheSize = 512;
+  uint32_t lookaheadSize = 128;
+  int32_t blockCycles = 512;
+};
+
+struct FlashCounters {
+  uint64_t reads = 0, readBytes = 0;
+  uint64_t progs = 0, progBytes = 0;
+  uint64_t erases = 0;
+};
+
+class FlashSim {
+ public:
+  FlashSim(const FlashGeometry& geo, const FlashCosts& costs);
+
+  const lfs_config* config() const { return &cfg_; }
+  uint64_t now_us() const { return clockUs_; }
+  const FlashCounters& counters() const { return ctr_; }
+  uint32_t max_block_erases() const;
+  double mean_block_erases() const;
+
+ private:
+  static int read(const lfs_config* c, lfs_block_t block, lfs_off_t off, void* buffer,
+                  lfs_size_t size);
+  static int prog(const lfs_config* c, lfs_block_t block, lfs_off_t off, const void* buffer,
+                  lfs_size_t size);
+  static int erase(const lfs_config* c, lfs_block_t block);
+  static int sync(const lfs_config* c);
+
+  FlashGeometry geo_;
+  FlashCosts costs_;
+  lfs_config cfg_;
+  std::vector<uint8_t> mem_;
+  std::vector<uint32_t> wear_;  // erases per block
+  FlashCounters ctr_;
+  uint64_t clockUs_;
+};
+
+// Shim hook: the Arduino LittleFS/millis()/micros() shim runs on this device.
+void shim_attach(FlashSim* flash);
+void shim_set_verbose(bool on);
\ No newline at end of file
@@ -0,0 +1,330 @@
+// msync-fsbench: run the firmware's event_log / songtime_log / xml_export code against
+// upstream littlefs on a simulated ESP32 flash and report per-operation
+// latency, erase counts and throughput across fill levels and cache /
+// lookahead settings. Latencies are modeled flash time, not host time.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <LittleFS.h>
+
+#include "event_log.h"
+#include "flash_sim.h"
+#include "songtime_log.h"
+#include "xml_export.h"
+
+static const size_t BALLAST_FILE_BYTES = 16 * 1024;
+static const uint32_t CHECKPOINT_MS = 10000;  // SYNC_CHECKPOINT_MS
+static const uint32_t SONG_TIME_PERIOD_MS = 150;  // phone's song-time updates
+
+/*
+  MEASUREMENT
+*/
+enum BenchOp { OP_MOUNT, OP_APPEND, OP_SONGTIME, OP_EXPORT, OP_RECOVER, OP_COUNT };
+static const char* OP_NAMES[OP_COUNT] = { "mount", "append", "songtime", "export", "recover" };
+
+struct OpSamples {
+  std::vector<uint32_t> us;  // modeled flash time per call
+  uint64_t bytes = 0;        // payload moved by those calls
+};
+
+struct BenchResult {
+  uint32_t cacheSize, lookaheadSize, fillPct;
+  size_t usedKb, totalKb;
+  OpSamples ops[OP_COUNT];
+  FlashCounters flash;       // workload only (ballast excluded)
+  uint32_t wearMax;
+  double wearMean;
+  uint32_t failures;         // export returned false / appends lost
+};
+
+static FlashSim* g_dev = nullptr;
+
+/**
+ * Time one call on the virtual flash clock.
+ */
+template <class Fn>
+static void timed(OpSamples& s, uint64_t bytes, Fn fn) {
+  uint64_t t0 = g_dev->now_us();
+  fn();
+  s.us.push_back((uint32_t)(g_dev->now_us() - t0));
+  s.bytes += bytes;
+}
+
+static double percentile_ms(std::vector<uint32_t>& us, double p) {
+  if (us.empty()) return 0;
+  std::sort(us.begin(), us.end());
+  size_t i = (size_t)(p * (us.size() - 1) + 0.5);
+  return us[i] / 1000.0;
+}
+
+/*
+  WORKLOAD
+*/
+/**
+ * Fill the filesystem with BALLAST_FILE_BYTES files up to pct of capacity.
+ * @return false if the filesystem filled up before reaching the target
+ */
+static bool write_ballast(uint32_t pct) {
+  static uint8_t block[FS_READ_BLOCK];
+  memset(block, 0xA5, sizeof(block));
+  size_t target = LittleFS.totalBytes() / 100 * pct;
+
+  for (int n = 0; LittleFS.usedBytes() + BALLAST_FILE_BYTES <= target; n++) {
+    char path[32];
+    snprintf(path, sizeof(path), "/ballast%03d.bin", n);
+    File f = LittleFS.open(path, "w");
+    if (!f) return false;
+    for (size_t done = 0; done < BALLAST_FILE_BYTES; done += sizeof(block))
+      if (f.write(block, sizeof(block)) != sizeof(block)) return false;
+    f.close();
+  }
+  return true;
+}
+
+/**
+ * Song-time updates for one checkpoint interval, then the loop hook that
+ * writes finished /songtime.bin blocks.
+ */
+static void song_time_updates(BenchResult& r, uint32_t fromMs, uint32_t toMs) {
+  for (uint32_t t = fromMs; t < toMs; t += SONG_TIME_PERIOD_MS) songtime_record(t);
+  size_t before = songtime_size();
+  timed(r.ops[OP_SONGTIME], 0, [&] { songtime_tick(true); });
+  r.ops[OP_SONGTIME].bytes += songtime_size() - before;
+}
+
+/**
+ * One recording session in the order SyncEngine logs it: SONG, CLIP_START,
+ * a CLIP_AT checkpoint every 10 s, the odd bridged pause, CLIP_END, with the
+ * song-time trace written alongside.
+ */
+static void run_session(BenchResult& r, int session, int songs, int exportEvery) {
+  OpSamples& app = r.ops[OP_APPEND];
+  for (int s = 0; s < songs; s++) {
+    int id = session * songs + s;
+    uint32_t durationMs = 150000 + (uint32_t)(id * 37) % 150 * 1000;
+    char uri[48], title[48], file[24];
+    snprintf(uri, sizeof(uri), "apple:track:%010d", 1440930000 + id);
+    snprintf(title, sizeof(title), "Bench Song %d", id);
+    snprintf(file, sizeof(file), "GOPR%04d.MP4", id % 10000);
+
+    auto append = [&](auto fn) {
+      size_t before = events_size();
+      timed(app, 0, fn);
+      size_t after = events_size();
+      if (after > before) app.bytes += after - before;
+      else r.failures++;
+    };
+
+    append([&] { log_song(uri, title, durationMs); });
+    uint32_t startMs = 1000 + (uint32_t)(id % 7) * 500;
+    append([&] { log_clip_start(file, startMs); });
+    for (uint32_t t = startMs + CHECKPOINT_MS; t < durationMs; t += CHECKPOINT_MS) {
+      song_time_updates(r, t - CHECKPOINT_MS, t);
+      if (id % 4 == 1 && t - startMs == 3 * CHECKPOINT_MS)
+        append([&] { log_clip_gap(file, t, t, 900); });
+      append([&] { log_clip_at(file, t); });
+    }
+    append([&] { log_clip_end(file, durationMs); });
+
+    if (exportEvery && (s + 1) % exportEvery == 0) {
+      timed(r.ops[OP_EXPORT], 0, [&] { if (!export_project()) r.failures++; });
+      static const char* FORMATS[] = { "xml", "fcpxml", "edl", "otio" };
+      for (const char* fmt : FORMATS) r.ops[OP_EXPORT].bytes += file_size(export_path(fmt));
+    }
+  }
+}
+
+/**
+ * Format a fresh device, fill it to fillPct, then run the sessions.
+ * @brief Each session ends with a remount and the boot-time log tail scan,
+ *        and the next one starts from a cleared log like a new shoot.
+ */
+static BenchResult run_config(const FlashGeometry& geo, const FlashCosts& costs,
+                              uint32_t fillPct, int sessions, int songs, int exportEvery) {
+  BenchResult r = {};
+  r.cacheSize = geo.cacheSize;
+  r.lookaheadSize = geo.lookaheadSize;
+  r.fillPct = fillPct;
+
+  FlashSim dev(geo, costs);
+  g_dev = &dev;
+  shim_attach(&dev);
+  if (!LittleFS.begin(true) || !write_ballast(fillPct)) r.failures++;
+  FlashCounters base = dev.counters();
+
+  for (int i = 0; i < sessions; i++) {
+    clear_events();
+    songtime_clear();
+    run_session(r, i, songs, exportEvery);
+
+    LittleFS.end();
+    timed(r.ops[OP_MOUNT], 0, [&] { if (!event_log_begin()) r.failures++; });
+    LogTail tail;
+    timed(r.ops[OP_RECOVER], std::min(events_size(), EVENTS_TAIL_BYTES),
+          [&] { recover_log_tail(&tail); });
+  }
+
+  r.usedKb = LittleFS.usedBytes() / 1024;
+  r.totalKb = LittleFS.totalBytes() / 1024;
+  const FlashCounters& c = dev.counters();
+  r.flash.reads = c.reads - base.reads;
+  r.flash.readBytes = c.readBytes - base.readBytes;
+  r.flash.progs = c.progs - base.progs;
+  r.flash.progBytes = c.progBytes - base.progBytes;
+  r.flash.erases = c.erases - base.erases;
+  r.wearMax = dev.max_block_erases();
+  r.wearMean = dev.mean_block_erases();
+
+  LittleFS.end();
+  shim_attach(nullptr);
+  g_dev = nullptr;
+  return r;
+}
+
+/*
+  REPORT
+*/
+static void print_result(BenchResult& r, bool csv) {
+  if (!csv) {
+    printf("cache %4u  lookahead %3u  fill %2u%%  used %4zu/%zu KB  erases %6llu  "
+           "prog %7.1f KB  read %8.1f KB  wear max %u mean %.2f%s\n",
+           r.cacheSize, r.lookaheadSize, r.fillPct, r.usedKb, r.totalKb,
+           (unsigned long long)r.flash.erases, r.flash.progBytes / 1024.0,
+           r.flash.readBytes / 1024.0, r.wearMax, r.wearMean,
+           r.failures ? "  FAILURES" : "");
+  }
+  for (int op = 0; op < OP_COUNT; op++) {
+    OpSamples& s = r.ops[op];
+    if (s.us.empty()) continue;
+    uint64_t totalUs = 0;
+    for (uint32_t us : s.us) totalUs += us;
+    double kbps = totalUs ? s.bytes / 1024.0 / (totalUs / 1e6) : 0;
+    double p50 = percentile_ms(s.us, 0.50), p90 = percentile_ms(s.us, 0.90);
+    double p99 = percentile_ms(s.us, 0.99), max = s.us.back() / 1000.0;
+    if (csv) {
+      printf("%u,%u,%u,%s,%zu,%.3f,%.3f,%.3f,%.3f,%.1f,%llu,%llu,%u,%.3f,%u\n",
+             r.cacheSize, r.lookaheadSize, r.fillPct, OP_NAMES[op], s.us.size(),
+             p50, p90, p99, max, kbps, (unsigned long long)r.flash.erases,
+             (unsigned long long)r.flash.progBytes, r.wearMax, r.wearMean, r.failures);
+    } else {
+      char rate[24] = "       -";
+      if (s.bytes) snprintf(rate, sizeof(rate), "%8.1f KB/s", kbps);
+      printf("  %-8s n=%-5zu p50 %8.2f  p90 %8.2f  p99 %8.2f  max %8.2f ms  %s\n",
+             OP_NAMES[op], s.us.size(), p50, p90, p99, max, rate);
+    }
+  }
+}
+
+/*
+  MAIN
+*/
+static void usage() {
+  fprintf(stderr,
+    "usage: msync-fsbench [options]\n"
+    "  --cache LIST       littlefs cache_size values (default 128,512,2048)\n"
+    "  --lookahead LIST   lookahead_size values (default 16,128)\n"
+    "  --fill LIST        ballast fill levels in %% of capacity (default 0,50,85)\n"
+    "  --sessions N       sessions per configuration (default 3)\n"
+    "  --songs N          songs per session (default 30)\n"
+    "  --export-every N   export_project() every N songs (default 10, 0 = never)\n"
+    "  --blocks N         flash blocks of 4096 bytes (default 352 = 1408 KB)\n"
+    "  --erase-us US      modeled sector erase time (default 45000)\n"
+    "  --csv              one CSV row per configuration and operation\n"
+    "  -v                 show the firmware's Serial output\n");
+}
+
+/**
+ * Parse "a,b,c" into unsigned values.
+ */
+static bool parse_list(const char* s, std::vector<uint32_t>& out) {
+  out.clear();
+  while (*s) {
+    char* end = nullptr;
+    unsigned long v = strtoul(s, &end, 10);
+    if (end == s) return false;
+    out.push_back((uint32_t)v);
+    s = *end == ',' ? end + 1 : end;
+    if (*end && *end != ',') return false;
+  }
+  return !out.empty();
+}
+
+int main(int argc, char** argv) {
+  std::vector<uint32_t> caches = { 128, 512, 2048 };
+  std::vector<uint32_t> lookaheads = { 16, 128 };
+  std::vector<uint32_t> fills = { 0, 50, 85 };
+  int sessions = 3, songs = 30, exportEvery = 10;
+  bool csv = false;
+  FlashGeometry geo;
+  FlashCosts costs;
+
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    bool more = i + 1 < argc;
+    bool ok = true;
+    if (a == "--cache" && more) ok = parse_list(argv[++i], caches);
+    else if (a == "--lookahead" && more) ok = parse_list(argv[++i], lookaheads);
+    else if (a == "--fill" && more) ok = parse_list(argv[++i], fills);
+    else if (a == "--sessions" && more) sessions = atoi(argv[++i]);
+    else if (a == "--songs" && more) songs = atoi(argv[++i]);
+    else if (a == "--export-every" && more) exportEvery = atoi(argv[++i]);
+    else if (a == "--blocks" && more) geo.blockCount = (uint32_t)atoi(argv[++i]);
+    else if (a == "--erase-us" && more) costs.eraseUs = (uint32_t)atoi(argv[++i]);
+    else if (a == "--csv") csv = true;
+    else if (a == "-v") shim_set_verbose(true);
+    else { usage(); return 2; }
+    if (!ok) { usage(); return 2; }
+  }
+
+  // littlefs asserts on these; reject them up front instead.
+  for (uint32_t c : caches) {
+    if (c % geo.progSize || geo.blockSize % c) {
+      fprintf(stderr, "cache %u: must be a multiple of %u and divide %u\n",
+              c, geo.progSize, geo.blockSize);
+      return 2;
+    }
+  }
+  for (uint32_t l : lookaheads) {
+    if (!l || l % 8) {
+      fprintf(stderr, "lookahead %u: must be a non-zero multiple of 8\n", l);
+      return 2;
+    }
+  }
+  for (uint32_t f : fills) {
+    if (f > 95) {
+      fprintf(stderr, "fill %u%%: leave room for the workload (max 95)\n", f);
+      return 2;
+    }
+  }
+
+  // Which littlefs the numbers came from (stderr keeps --csv clean)
+#ifdef LFS_VERSION
+  fprintf(csv ? stderr : stdout, "littlefs %u.%u, disk format %u.%u\n",
+          (unsigned)LFS_VERSION_MAJOR, (unsigned)LFS_VERSION_MINOR,
+          (unsigned)LFS_DISK_VERSION_MAJOR, (unsigned)LFS_DISK_VERSION_MINOR);
+#else
+  fprintf(csv ? stderr : stdout, "littlefs (lfs.h without LFS_VERSION: not upstream)\n");
+#endif
+  if (csv) {
+    printf("cache,lookahead,fill_pct,op,n,p50_ms,p90_ms,p99_ms,max_ms,kb_per_s,"
+           "erases,prog_bytes,wear_max,wear_mean,failures\n");
+  }
+  int failed = 0;
+  for (uint32_t c : caches) {
+    for (uint32_t l : lookaheads) {
+      for (uint32_t f : fills) {
+        geo.cacheSize = c;
+        geo.lookaheadSize = l;
+        BenchResult r = run_config(geo, costs, f, sessions, songs, exportEvery);
+        print_result(r, csv);
+        if (r.failures) failed++;
+      }
+    }
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <type_traits>
+
+/*
+  Host shim for msync-fsbench: only the Arduino core surface that
+  firmware/src/event_log.cpp, songtime_log.cpp and xml_export.cpp use.
+  millis()/micros() run on the simulated flash's virtual clock.
+*/
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+
+// The bench is single-threaded; critical sections are no-ops.
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+
+template <class A, class B>
+static inline typename std::common_type<A, B>::type min(A a, B b) {
+  return b < a ? b : a;
+}
+
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(const uint8_t* data, size_t len) = 0;
+
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+  size_t println(const char* s) { return print(s) + print("\r\n"); }
+  size_t println() { return print("\r\n"); }
+  size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class String {
+ public:
+  bool reserve(size_t n) { s_.reserve(n); return true; }
+  bool concat(const char* data, size_t len) { s_.append(data, len); return true; }
+  const char* c_str() const { return s_.c_str(); }
+  size_t length() const { return s_.size(); }
+
+ private:
+  std::string s_;
+};
+
+// Console output is discarded unless the bench runs verbose.
+class HardwareSerial : public Print {
+ public:
+  size_t write(const uint8_t* data, size_t len) override;
+  using Print::write;
+};
+
+extern HardwareSerial Serial;
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+#include <Arduino.h>
+
+#include <memory>
+
+struct ShimFile;
+
+/**
+ * Arduino File handle over a littlefs file (copies share the open file).
+ */
+class File : public Print {
+ public:
+  File() {}
+  explicit File(std::shared_ptr<ShimFile> f) : f_(f) {}
+
+  operator bool() const { return (bool)f_; }
+  size_t write(const uint8_t* data, size_t len) override;
+  using Print::write;
+  size_t read(uint8_t* buf, size_t len);
+  bool seek(uint32_t pos);
+  size_t size() const;
+  bool isDirectory() const { return false; }
+  void close() { f_.reset(); }
+
+ private:
+  std::shared_ptr<ShimFile> f_;
+};
+
+class LittleFSClass {
+ public:
+  bool begin(bool formatOnFail = false);
+  void end();
+  bool format();
+  File open(const char* path, const char* mode = "r");
+  bool exists(const char* path);
+  bool remove(const char* path);
+  size_t totalBytes();
+  size_t usedBytes();
+};
+
+extern LittleFSClass LittleFS;
\ No newline at end of file
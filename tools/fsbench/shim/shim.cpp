@@ -0,0 +1,144 @@
+#include "Arduino.h"
+#include "LittleFS.h"
+
+#include "flash_sim.h"
+
+static FlashSim* g_flash = nullptr;
+static lfs_t g_lfs;
+static bool g_mounted = false;
+static bool g_verbose = false;
+
+HardwareSerial Serial;
+LittleFSClass LittleFS;
+
+void shim_attach(FlashSim* flash) {
+  if (g_mounted) lfs_unmount(&g_lfs);
+  g_mounted = false;
+  g_flash = flash;
+}
+
+void shim_set_verbose(bool on) {
+  g_verbose = on;
+}
+
+/*
+  ARDUINO CORE
+*/
+uint32_t millis() {
+  return g_flash ? (uint32_t)(g_flash->now_us() / 1000) : 0;
+}
+
+uint32_t micros() {
+  return g_flash ? (uint32_t)g_flash->now_us() : 0;
+}
+
+void delay(uint32_t ms) {
+  (void)ms;
+}
+
+size_t Print::printf(const char* fmt, ...) {
+  char buf[256];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+  if (n < 0) return 0;
+  return write((const uint8_t*)buf, (size_t)n < sizeof(buf) ? n : sizeof(buf) - 1);
+}
+
+size_t HardwareSerial::write(const uint8_t* data, size_t len) {
+  if (g_verbose) fwrite(data, 1, len, stderr);
+  return len;
+}
+
+/*
+  FILE
+*/
+struct ShimFile {
+  lfs_file_t file;
+  bool open = false;
+  ~ShimFile() {
+    if (open && g_mounted) lfs_file_close(&g_lfs, &file);
+  }
+};
+
+size_t File::write(const uint8_t* data, size_t len) {
+  if (!f_) return 0;
+  lfs_ssize_t n = lfs_file_write(&g_lfs, &f_->file, data, len);
+  return n < 0 ? 0 : (size_t)n;
+}
+
+size_t File::read(uint8_t* buf, size_t len) {
+  if (!f_) return 0;
+  lfs_ssize_t n = lfs_file_read(&g_lfs, &f_->file, buf, len);
+  return n < 0 ? 0 : (size_t)n;
+}
+
+bool File::seek(uint32_t pos) {
+  return f_ && lfs_file_seek(&g_lfs, &f_->file, pos, LFS_SEEK_SET) >= 0;
+}
+
+size_t File::size() const {
+  if (!f_) return 0;
+  lfs_soff_t n = lfs_file_size(&g_lfs, &f_->file);
+  return n < 0 ? 0 : (size_t)n;
+}
+
+/*
+  FILESYSTEM
+*/
+/**
+ * Mount like esp_littlefs: format and retry if the mount fails and asked to.
+ */
+bool LittleFSClass::begin(bool formatOnFail) {
+  if (g_mounted) return true;
+  if (!g_flash) return false;
+  int err = lfs_mount(&g_lfs, g_flash->config());
+  if (err && formatOnFail) {
+    if (lfs_format(&g_lfs, g_flash->config()) != 0) return false;
+    err = lfs_mount(&g_lfs, g_flash->config());
+  }
+  g_mounted = err == 0;
+  return g_mounted;
+}
+
+void LittleFSClass::end() {
+  if (g_mounted) lfs_unmount(&g_lfs);
+  g_mounted = false;
+}
+
+bool LittleFSClass::format() {
+  end();
+  return g_flash && lfs_format(&g_lfs, g_flash->config()) == 0;
+}
+
+File LittleFSClass::open(const char* path, const char* mode) {
+  if (!g_mounted) return File();
+  int flags = LFS_O_RDONLY;
+  if (mode[0] == 'w') flags = LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC;
+  if (mode[0] == 'a') flags = LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND;
+  if (mode[0] && mode[1] == '+') flags = (flags & ~(LFS_O_RDONLY | LFS_O_WRONLY)) | LFS_O_RDWR;
+
+  std::shared_ptr<ShimFile> f(new ShimFile());
+  f->open = lfs_file_open(&g_lfs, &f->file, path, flags) == 0;
+  return f->open ? File(f) : File();
+}
+
+bool LittleFSClass::exists(const char* path) {
+  lfs_info info;
+  return g_mounted && lfs_stat(&g_lfs, path, &info) == 0;
+}
+
+bool LittleFSClass::remove(const char* path) {
+  return g_mounted && lfs_remove(&g_lfs, path) == 0;
+}
+
+size_t LittleFSClass::totalBytes() {
+  return g_flash ? (size_t)g_flash->config()->block_size * g_flash->config()->block_count : 0;
+}
+
+size_t LittleFSClass::usedBytes() {
+  if (!g_mounted) return 0;
+  lfs_ssize_t blocks = lfs_fs_size(&g_lfs);
+  return blocks < 0 ? 0 : (size_t)blocks * g_flash->config()->block_size;
+}
@@ -0,0 +1,382 @@
+// msync-logconv: batch-convert events.log dumps into the same timeline
+// files the firmware writes (/project.xml is reproduced byte-for-byte).
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "songtime_trace.h"
+#include "timeline.h"
+#include "timeline_writers.h"
+
+/*
+  OUTPUT SINK
+*/
+/**
+ * TimelineSink that batches writer output into large write(2) calls.
+ */
+class FdSink : public TimelineSink {
+ public:
+  explicit FdSink(int fd) : fd_(fd), fill_(0), bytes_(0), ok_(fd >= 0) {}
+
+  void write(const char* data, size_t len) override {
+    bytes_ += len;
+    if (fill_ + len > sizeof(buf_)) flush();
+    if (len >= sizeof(buf_)) { raw_write(data, len); return; }
+    memcpy(buf_ + fill_, data, len);
+    fill_ += len;
+  }
+
+  bool close() {
+    flush();
+    if (fd_ >= 0 && ::close(fd_) != 0) ok_ = false;
+    fd_ = -1;
+    return ok_;
+  }
+
+  size_t bytes() const { return bytes_; }
+
+ private:
+  void flush() {
+    raw_write(buf_, fill_);
+    fill_ = 0;
+  }
+
+  void raw_write(const char* p, size_t n) {
+    while (ok_ && n) {
+      ssize_t w = ::write(fd_, p, n);
+      if (w < 0) { if (errno == EINTR) continue; ok_ = false; return; }
+      p += w;
+      n -= (size_t)w;
+    }
+  }
+
+  int fd_;
+  char buf_[64 * 1024];
+  size_t fill_;
+  size_t bytes_;
+  bool ok_;
+};
+
+/*
+  OPTIONS
+*/
+struct Options {
+  std::vector<std::string> inputs;
+  std::string outDir;
+  bool formats[4] = { true, false, false, false };  // xml, fcpxml, edl, otio
+  unsigned jobs = 0;
+  unsigned repeat = 1;
+  bool bench = false;
+  bool noWrite = false;
+  bool songtime = true;
+  FrameRate rate = FPS_29_97;
+};
+
+static const char* FORMAT_NAMES[4] = { "xml", "fcpxml", "edl", "otio" };
+static const char* FORMAT_EXT[4] = { ".xml", ".fcpxml", ".edl", ".otio" };
+
+struct NamedRate {
+  const char* name;
+  FrameRate rate;
+};
+
+static const NamedRate RATES[] = {
+  { "23.976", FPS_23_976 }, { "25", FPS_25 }, { "29.97", FPS_29_97 },
+  { "29.97df", FPS_29_97_DF }, { "30", FPS_30 }, { "60", FPS_60 },
+};
+
+static void usage() {
+  fprintf(stderr,
+    "usage: msync-logconv [options] events.log...\n"
+    "  -f LIST    formats to write: xml,fcpxml,edl,otio or all (default xml)\n"
+    "  -o DIR     write <stem>.<ext> into DIR (default: next to each input;\n"
+    "             an input named events.log produces project.<ext>, or\n"
+    "             <parent dir>.<ext> with -o, e.g. rig03/events.log -> rig03.xml)\n"
+    "  -r RATE    timecode rate: 23.976, 25, 29.97, 29.97df, 30 or 60\n"
+    "             (default 29.97, the firmware's EXPORT_RATE)\n"
+    "  -j N       worker threads (default: all cores)\n"
+    "  --bench    print throughput (MB/s, logs/s)\n"
+    "  --repeat N convert the input set N times (with --bench; only the\n"
+    "             first round writes files)\n"
+    "  --no-write parse and render but discard output\n"
+    "  --no-songtime  ignore song-time traces (songtime.bin next to events.log,\n"
+    "             <stem>.songtime.bin next to other inputs)\n");
+}
+
+/**
+ * Parse a comma-separated format list into the options' format mask.
+ * @return false if an unknown format name was given
+ */
+static bool parse_formats(const char* list, Options& o) {
+  for (bool& f : o.formats) f = false;
+  std::string s(list);
+  size_t pos = 0;
+  while (pos <= s.size()) {
+    size_t c = s.find(',', pos);
+    std::string name = s.substr(pos, c == std::string::npos ? std::string::npos : c - pos);
+    bool known = false;
+    for (int i = 0; i < 4; i++) {
+      if (name == "all" || name == FORMAT_NAMES[i]) { o.formats[i] = true; known = true; }
+    }
+    if (!known) return false;
+    if (c == std::string::npos) break;
+    pos = c + 1;
+  }
+  return true;
+}
+
+/**
+ * Look up a -r rate name.
+ * @return false if the name is not in RATES
+ */
+static bool parse_rate(const char* name, Options& o) {
+  for (const NamedRate& r : RATES) {
+    if (strcmp(name, r.name) == 0) { o.rate = r.rate; return true; }
+  }
+  return false;
+}
+
+/**
+ * Build the output path for one input and format.
+ * @param in Input log path
+ * @param fmt Format index into FORMAT_EXT
+ * @param outDir Output directory, or empty to write next to the input
+ * @brief Offloaded logs are all named events.log, so with -o the stem comes
+ *        from their directory (rig03/events.log -> rig03.<ext>).
+ */
+static std::string output_path(const std::string& in, int fmt, const std::string& outDir) {
+  size_t slash = in.rfind('/');
+  std::string dir = slash == std::string::npos ? "." : in.substr(0, slash);
+  std::string base = slash == std::string::npos ? in : in.substr(slash + 1);
+
+  std::string stem = base;
+  if (base == "events.log") {
+    stem = "project";
+    if (!outDir.empty() && slash != std::string::npos) {
+      while (dir.size() > 1 && dir.back() == '/') dir.pop_back();
+      size_t up = dir.rfind('/');
+      std::string parent = up == std::string::npos ? dir : dir.substr(up + 1);
+      if (!parent.empty() && parent != "." && parent != "..") stem = parent;
+    }
+  } else {
+    size_t dot = base.rfind('.');
+    if (dot != std::string::npos && dot > 0) stem = base.substr(0, dot);
+  }
+  return (outDir.empty() ? dir : outDir) + "/" + stem + FORMAT_EXT[fmt];
+}
+
+/**
+ * Song-time trace that belongs to an input: the device's /songtime.bin
+ * when the input is an offloaded events.log, else <stem>.songtime.bin.
+ */
+static std::string songtime_path(const std::string& in) {
+  size_t slash = in.rfind('/');
+  std::string dir = slash == std::string::npos ? "." : in.substr(0, slash);
+  std::string base = slash == std::string::npos ? in : in.substr(slash + 1);
+  if (base == "events.log") return dir + "/songtime.bin";
+
+  size_t dot = base.rfind('.');
+  std::string stem = dot != std::string::npos && dot > 0 ? base.substr(0, dot) : base;
+  return dir + "/" + stem + ".songtime.bin";
+}
+
+/**
+ * Refine a parsed timeline from the input's song-time trace, if it has one.
+ */
+static void apply_songtime(const std::string& path, Timeline* tl) {
+  FILE* f = fopen(songtime_path(path).c_str(), "rb");
+  if (!f) return;
+  std::vector<uint8_t> data;
+  uint8_t buf[64 * 1024];
+  for (size_t n; (n = fread(buf, 1, sizeof(buf), f)) > 0;) data.insert(data.end(), buf, buf + n);
+  fclose(f);
+  songtime_refine_buffer(tl, data.data(), data.size(), nullptr);
+}
+
+/**
+ * Make sure no two inputs write the same file (the workers would truncate
+ * each other's output).
+ * @return false after printing the first collision
+ */
+static bool check_output_paths(const Options& o) {
+  std::map<std::string, const std::string*> owner;
+  for (const std::string& in : o.inputs) {
+    for (int i = 0; i < 4; i++) {
+      if (!o.formats[i]) continue;
+      std::string out = output_path(in, i, o.outDir);
+      auto ins = owner.emplace(out, &in);
+      if (!ins.second) {
+        fprintf(stderr, "%s and %s would both write %s\n",
+                ins.first->second->c_str(), in.c_str(), out.c_str());
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/*
+  CONVERSION
+*/
+struct Result {
+  size_t inBytes;
+  size_t outBytes;
+  bool ok;
+};
+
+/**
+ * Convert one log: mmap it, parse once, refine from its song-time trace,
+ * emit every selected format in one pass.
+ * @param path Input events.log
+ * @param o Options
+ * @param write false to render into /dev/null (--no-write, --repeat rounds)
+ * @param tl Per-thread timeline scratch (large; reused between files)
+ * @return Byte counts and success flag
+ */
+static Result convert_one(const std::string& path, const Options& o, bool write, Timeline* tl) {
+  Result r = { 0, 0, false };
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "%s: %s\n", path.c_str(), strerror(errno));
+    return r;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    fprintf(stderr, "%s: %s\n", path.c_str(), strerror(errno));
+    ::close(fd);
+    return r;
+  }
+  r.inBytes = (size_t)st.st_size;
+
+  TimelineParser parser(tl);
+  if (r.inBytes) {
+    void* map = mmap(nullptr, r.inBytes, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    if (map == MAP_FAILED) {
+      fprintf(stderr, "%s: mmap: %s\n", path.c_str(), strerror(errno));
+      ::close(fd);
+      return r;
+    }
+    madvise(map, r.inBytes, MADV_SEQUENTIAL);
+    parser.feed((const char*)map, r.inBytes);  // memchr-driven line split
+    munmap(map, r.inBytes);
+  }
+  parser.finish();
+  ::close(fd);
+  if (o.songtime) apply_songtime(path, tl);
+
+  LegacyXmlWriter xml;
+  FcpxmlWriter fcpxml(o.rate);
+  Cmx3600EdlWriter edl(o.rate);
+  OtioJsonWriter otio(o.rate);
+  TimelineWriter* all[4] = { &xml, &fcpxml, &edl, &otio };
+
+  TimelineWriter* writers[4];
+  FdSink* sinks[4];
+  int n = 0;
+  r.ok = true;
+  for (int i = 0; i < 4; i++) {
+    if (!o.formats[i]) continue;
+    int ofd = -1;
+    if (!write) {
+      ofd = ::open("/dev/null", O_WRONLY);
+    } else {
+      std::string out = output_path(path, i, o.outDir);
+      ofd = ::open(out.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (ofd < 0) fprintf(stderr, "%s: %s\n", out.c_str(), strerror(errno));
+    }
+    writers[n] = all[i];
+    sinks[n] = new FdSink(ofd);
+    n++;
+  }
+
+  timeline_emit(*tl, writers, (TimelineSink* const*)sinks, n, nullptr, nullptr);
+
+  for (int i = 0; i < n; i++) {
+    if (!sinks[i]->close()) r.ok = false;
+    r.outBytes += sinks[i]->bytes();
+    delete sinks[i];
+  }
+  return r;
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (a == "-f" && i + 1 < argc) {
+      if (!parse_formats(argv[++i], o)) { usage(); return 2; }
+    } else if (a == "-o" && i + 1 < argc) {
+      o.outDir = argv[++i];
+    } else if (a == "-r" && i + 1 < argc) {
+      if (!parse_rate(argv[++i], o)) { usage(); return 2; }
+    } else if (a == "-j" && i + 1 < argc) {
+      o.jobs = (unsigned)atoi(argv[++i]);
+    } else if (a == "--repeat" && i + 1 < argc) {
+      o.repeat = (unsigned)atoi(argv[++i]);
+    } else if (a == "--bench") {
+      o.bench = true;
+    } else if (a == "--no-write") {
+      o.noWrite = true;
+    } else if (a == "--no-songtime") {
+      o.songtime = false;
+    } else if (a == "-h" || a == "--help" || (!a.empty() && a[0] == '-')) {
+      usage();
+      return a[0] == '-' && a != "-h" && a != "--help" ? 2 : 0;
+    } else {
+      o.inputs.push_back(a);
+    }
+  }
+  if (o.inputs.empty()) { usage(); return 2; }
+  if (!o.noWrite && !check_output_paths(o)) return 2;
+  if (o.repeat == 0) o.repeat = 1;
+  if (o.jobs == 0) o.jobs = std::thread::hardware_concurrency();
+  if (o.jobs == 0) o.jobs = 1;
+
+  size_t total = o.inputs.size() * o.repeat;
+  if (o.jobs > total) o.jobs = (unsigned)total;
+
+  std::atomic<size_t> next(0), inBytes(0), outBytes(0), failed(0);
+  auto t0 = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> pool;
+  for (unsigned t = 0; t < o.jobs; t++) {
+    pool.emplace_back([&]() {
+      Timeline* tl = new Timeline;
+      for (size_t k; (k = next.fetch_add(1)) < total;) {
+        bool write = !o.noWrite && k < o.inputs.size();
+        Result r = convert_one(o.inputs[k % o.inputs.size()], o, write, tl);
+        inBytes += r.inBytes;
+        outBytes += r.outBytes;
+        if (!r.ok) failed++;
+      }
+      delete tl;
+    });
+  }
+  for (std::thread& th : pool) th.join();
+
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  if (o.bench) {
+    if (secs <= 0) secs = 1e-9;
+    printf("logs     %zu\n", total);
+    printf("threads  %u\n", o.jobs);
+    printf("in       %.2f MB\n", inBytes / 1e6);
+    printf("out      %.2f MB\n", outBytes / 1e6);
+    printf("elapsed  %.3f s\n", secs);
+    printf("rate     %.1f MB/s  %.0f logs/s\n", inBytes / 1e6 / secs, total / secs);
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,36 @@
+# Golden-file test for one msync-logconv fixture (run by ctest):
+#   cmake -DLOGCONV=path -DCASE=name -DSRC=tools/logconv/tests -DOUT=dir -P golden.cmake
+# Converts SRC/CASE/events.log (plus its songtime.bin, if any) to every format
+# and compares each file with SRC/expected/CASE.<ext>. Extra msync-logconv
+# options for a case (e.g. "-r 29.97df") go in SRC/CASE/args. After an
+# intended output change, refresh the expected files with
+#   msync-logconv -f all -o tools/logconv/tests/expected tools/logconv/tests/*/events.log
+# plus the case's args for each case that has them.
+
+file(REMOVE_RECURSE ${OUT})
+file(MAKE_DIRECTORY ${OUT})
+set(args "")
+if(EXISTS ${SRC}/${CASE}/args)
+  file(READ ${SRC}/${CASE}/args args)
+  separate_arguments(args UNIX_COMMAND "${args}")
+endif()
+execute_process(
+  COMMAND ${LOGCONV} -f all -j 1 ${args} -o ${OUT} ${SRC}/${CASE}/events.log
+  RESULT_VARIABLE rc)
+if(NOT rc EQUAL 0)
+  message(FATAL_ERROR "msync-logconv failed on ${CASE} (${rc})")
+endif()
+
+set(failed "")
+foreach(ext xml fcpxml edl otio)
+  execute_process(
+    COMMAND ${CMAKE_COMMAND} -E compare_files
+      ${OUT}/${CASE}.${ext} ${SRC}/expected/${CASE}.${ext}
+    RESULT_VARIABLE diff)
+  if(NOT diff EQUAL 0)
+    list(APPEND failed ${CASE}.${ext})
+  endif()
+endforeach()
+if(failed)
+  message(FATAL_ERROR "output differs from expected: ${failed} (see ${OUT})")
+endif()
@@ -0,0 +1,790 @@
+// msync-merge: combine events.log files from several rigs into one
+// multi-track project. Logs are aligned on shared songs (each line's
+// dev/seq/t stamp), then k-way merged in one streaming pass.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "timecode.h"
+#include "timeline.h"
+
+static const uint32_t ALIGN_TOL_MS = 500;       // default clock agreement window
+static const size_t MAX_ANCHORS = 4096;         // per boot segment
+static const uint32_t SONG_FLUSH_MS = 10000;    // emit a song this long after it ends
+static const size_t READ_BUF = 32 * 1024;       // per open log
+static const FrameRate MERGE_RATE = FPS_29_97;  // same as the firmware exports
+
+/*
+  LINE READER
+*/
+/**
+ * Buffered line reader.
+ * @brief Memory is READ_BUF plus one line regardless of file size. Lines
+ *        longer than the logger can write are skipped.
+ */
+class LineReader {
+ public:
+  ~LineReader() { if (f_) fclose(f_); }
+
+  bool open(const char* path) {
+    f_ = fopen(path, "rb");
+    if (!f_) return false;
+    buf_.reset(new char[READ_BUF]);
+    setvbuf(f_, buf_.get(), _IOFBF, READ_BUF);
+    return true;
+  }
+
+  // Next line without CR/LF, or nullptr at end of file.
+  const char* next() {
+    while (fgets(line_, sizeof(line_), f_)) {
+      size_t n = strlen(line_);
+      pos_ = next_;
+      next_ += n;
+      if (n && line_[n - 1] != '\n' && !feof(f_)) {
+        int c;
+        while ((c = fgetc(f_)) != EOF) { next_++; if (c == '\n') break; }
+        continue;
+      }
+      while (n && (line_[n - 1] == '\n' || line_[n - 1] == '\r')) line_[--n] = '\0';
+      return line_;
+    }
+    return nullptr;
+  }
+
+  uint64_t offset() const { return pos_; }  // file offset of the last line returned
+  uint64_t bytes() const { return next_; }
+
+ private:
+  FILE* f_ = nullptr;
+  std::unique_ptr<char[]> buf_;
+  char line_[512];
+  uint64_t pos_ = 0;
+  uint64_t next_ = 0;
+};
+
+/*
+  RECORDS
+*/
+enum RecType { REC_SONG, REC_START, REC_AT, REC_GAP, REC_END, REC_LOST, REC_OTHER };
+
+struct Record {
+  RecType type;
+  bool stamped;
+  EventStamp stamp;
+  uint32_t songMs;      // CLIP_START / CLIP_AT / CLIP_END songMs, CLIP_GAP toMs
+  char file[64];
+  char uri[192];
+  char title[96];
+  uint32_t durationMs;
+};
+
+static bool get_quoted(const char* line, const char* key, char* dst, size_t cap) {
+  const char* p = strstr(line, key);
+  if (!p) return false;
+  p += strlen(key);
+  const char* e = strchr(p, '"');
+  size_t n = e ? (size_t)(e - p) : strlen(p);
+  if (n >= cap) n = cap - 1;
+  memcpy(dst, p, n);
+  dst[n] = '\0';
+  return true;
+}
+
+static uint32_t get_u32(const char* line, const char* key) {
+  const char* p = strstr(line, key);
+  return p ? (uint32_t)strtoul(p + strlen(key), nullptr, 10) : 0;
+}
+
+/**
+ * Classify one log line and pull out the fields the merge needs.
+ */
+static void parse_record(const char* line, Record* r) {
+  r->type = REC_OTHER;
+  r->stamped = parse_event_stamp(line, &r->stamp);
+  r->songMs = 0;
+  r->file[0] = '\0';
+  if (strncmp(line, "SONG ", 5) == 0) {
+    r->type = REC_SONG;
+    r->uri[0] = r->title[0] = '\0';
+    get_quoted(line, "uri=\"", r->uri, sizeof(r->uri));
+    get_quoted(line, "title=\"", r->title, sizeof(r->title));
+    r->durationMs = get_u32(line, "durationMs=");
+    return;
+  }
+  if (strncmp(line, "CLIP_START", 10) == 0) r->type = REC_START;
+  else if (strncmp(line, "CLIP_AT ", 8) == 0) r->type = REC_AT;
+  else if (strncmp(line, "CLIP_GAP ", 9) == 0) r->type = REC_GAP;
+  else if (strncmp(line, "CLIP_END", 8) == 0) r->type = REC_END;
+  else if (strncmp(line, "CLIP_LOST ", 10) == 0) r->type = REC_LOST;
+  else return;
+  get_quoted(line, "file=\"", r->file, sizeof(r->file));
+  r->songMs = get_u32(line, r->type == REC_GAP ? "toMs=" : "songMs=");
+}
+
+static uint32_t fnv1a(const char* s) {
+  uint32_t h = 2166136261u;
+  for (; *s; s++) h = (h ^ (uint8_t)*s) * 16777619u;
+  return h;
+}
+
+/*
+  PASS 1: SEGMENTS AND ANCHORS
+  A segment is one boot of one device: t restarts at 0 on every boot, so each
+  needs its own clock offset. Anchors are "song <uri> was at 0 ms at local
+  time <epoch>", taken from clip lines while the song plays; rigs that heard
+  the same playback share anchors up to their clock offset.
+*/
+struct Anchor {
+  uint32_t uriHash;
+  int64_t epoch;
+};
+
+struct Segment {
+  int file;
+  uint64_t begin;       // file offset of the first line
+  char dev[16];
+  uint32_t tMin, tMax;
+  uint64_t records;
+  std::vector<Anchor> anchors;
+  int64_t offset;       // aligned = t + offset
+  bool aligned;
+  int alignedTo;        // segment it was matched against (-1 = reference)
+  int votes;
+};
+
+struct LogFile {
+  std::string path;
+  int firstSeg, segCount;
+  uint64_t bytes;
+};
+
+/**
+ * Scan one log for boot segments and song anchors.
+ * @return false if the file can't be read
+ */
+static bool scan_file(int fileIdx, LogFile& lf, std::vector<Segment>& segs) {
+  LineReader rd;
+  if (!rd.open(lf.path.c_str())) return false;
+  lf.firstSeg = (int)segs.size();
+  lf.segCount = 0;
+
+  uint32_t songHash = 0;
+  Record r;
+  Segment* cur = nullptr;
+  for (const char* line = rd.next(); line; line = rd.next()) {
+    parse_record(line, &r);
+    if (r.type == REC_SONG) songHash = fnv1a(r.uri);
+    if (!r.stamped) {
+      if (cur) cur->records++;
+      continue;
+    }
+
+    if (!cur || strcmp(cur->dev, r.stamp.dev) != 0 || r.stamp.t < cur->tMax) {
+      Segment s = {};
+      s.file = fileIdx;
+      s.begin = lf.segCount ? rd.offset() : 0;  // unstamped preamble joins the first
+      memcpy(s.dev, r.stamp.dev, sizeof(s.dev));
+      s.tMin = s.tMax = r.stamp.t;
+      s.alignedTo = -1;
+      segs.push_back(std::move(s));
+      cur = &segs.back();
+      lf.segCount++;
+    }
+    cur->records++;
+    cur->tMax = r.stamp.t;
+
+    bool anchor = songHash && (r.type == REC_START || r.type == REC_AT || r.type == REC_GAP);
+    if (!anchor || cur->anchors.size() >= MAX_ANCHORS) continue;
+    int64_t epoch = (int64_t)r.stamp.t - r.songMs;
+    if (!cur->anchors.empty()) {
+      const Anchor& last = cur->anchors.back();
+      // One anchor per continuous playback: checkpoints of it repeat the epoch
+      if (last.uriHash == songHash && llabs(last.epoch - epoch) <= (int64_t)ALIGN_TOL_MS) continue;
+    }
+    cur->anchors.push_back(Anchor{ songHash, epoch });
+  }
+  lf.bytes = rd.bytes();
+  return true;
+}
+
+/*
+  CLOCK ALIGNMENT
+*/
+struct Edge {
+  int votes;
+  int64_t delta;  // offset[b] - offset[a]
+};
+
+/**
+ * Find the clock difference between two segments from their shared songs.
+ * @param a, b Anchors of each segment, sorted by song hash
+ * @brief Every anchor pair with the same song votes for epochA - epochB; the
+ *        largest cluster of votes within tol wins (repeat plays of a song
+ *        produce scattered votes that don't cluster).
+ */
+static Edge match_segments(const std::vector<Anchor>& a, const std::vector<Anchor>& b,
+                           uint32_t tol, std::vector<int64_t>& diffs) {
+  diffs.clear();
+  size_t i = 0, j = 0;
+  while (i < a.size() && j < b.size()) {
+    if (a[i].uriHash < b[j].uriHash) { i++; continue; }
+    if (b[j].uriHash < a[i].uriHash) { j++; continue; }
+    size_t i1 = i, j1 = j;
+    while (i1 < a.size() && a[i1].uriHash == a[i].uriHash) i1++;
+    while (j1 < b.size() && b[j1].uriHash == b[j].uriHash) j1++;
+    for (size_t x = i; x < i1; x++)
+      for (size_t y = j; y < j1; y++) diffs.push_back(a[x].epoch - b[y].epoch);
+    i = i1;
+    j = j1;
+  }
+
+  Edge best = { 0, 0 };
+  if (diffs.empty()) return best;
+  std::sort(diffs.begin(), diffs.end());
+  size_t lo = 0;
+  for (size_t hi = 0; hi < diffs.size(); hi++) {
+    while (diffs[hi] - diffs[lo] > (int64_t)tol) lo++;
+    int votes = (int)(hi - lo + 1);
+    if (votes > best.votes) {
+      best.votes = votes;
+      best.delta = diffs[lo + (hi - lo) / 2];
+    }
+  }
+  return best;
+}
+
+/**
+ * Two boots of one device can't overlap in time.
+ */
+static bool overlaps_same_device(const std::vector<Segment>& segs, int s, int64_t offset) {
+  int64_t b0 = segs[s].tMin + offset, b1 = segs[s].tMax + offset;
+  for (size_t i = 0; i < segs.size(); i++) {
+    const Segment& o = segs[i];
+    if ((int)i == s || !o.aligned || strcmp(o.dev, segs[s].dev) != 0) continue;
+    if (b0 <= (int64_t)o.tMax + o.offset && (int64_t)o.tMin + o.offset <= b1) return true;
+  }
+  return false;
+}
+
+/**
+ * Give every segment a clock offset onto the reference segment's clock.
+ * @brief Greedy maximum spanning tree over song-vote edges: the segment with
+ *        the most anchors is the reference, then the strongest edge from the
+ *        aligned set is taken until no segment shares a song with it. Left-
+ *        over segments are placed right after the previous boot in their file.
+ */
+static void align_segments(std::vector<Segment>& segs, const std::vector<LogFile>& files,
+                           uint32_t tol) {
+  if (segs.empty()) return;
+  int n = (int)segs.size();
+  int ref = 0;
+  for (int i = 1; i < n; i++)
+    if (segs[i].anchors.size() > segs[ref].anchors.size()) ref = i;
+  segs[ref].aligned = true;
+  segs[ref].offset = 0;
+
+  std::vector<std::vector<Anchor>> byHash(n);
+  for (int i = 0; i < n; i++) {
+    byHash[i] = segs[i].anchors;
+    std::sort(byHash[i].begin(), byHash[i].end(),
+              [](const Anchor& x, const Anchor& y) { return x.uriHash < y.uriHash; });
+  }
+
+  std::vector<Edge> edges((size_t)n * n);
+  std::vector<int64_t> diffs;
+  for (int a = 0; a < n; a++)
+    for (int b = a + 1; b < n; b++) {
+      Edge e = match_segments(byHash[a], byHash[b], tol, diffs);
+      edges[(size_t)a * n + b] = e;
+      edges[(size_t)b * n + a] = Edge{ e.votes, -e.delta };
+    }
+
+  for (;;) {
+    int bestA = -1, bestB = -1, bestVotes = 0;
+    for (int a = 0; a < n; a++) {
+      if (!segs[a].aligned) continue;
+      for (int b = 0; b < n; b++) {
+        if (segs[b].aligned) continue;
+        const Edge& e = edges[(size_t)a * n + b];
+        if (e.votes <= bestVotes) continue;
+        if (overlaps_same_device(segs, b, segs[a].offset + e.delta)) continue;
+        bestA = a; bestB = b; bestVotes = e.votes;
+      }
+    }
+    if (bestB < 0) break;
+    Segment& s = segs[bestB];
+    s.offset = segs[bestA].offset + edges[(size_t)bestA * n + bestB].delta;
+    s.aligned = true;
+    s.alignedTo = bestA;
+    s.votes = bestVotes;
+  }
+
+  for (const LogFile& lf : files) {
+    for (int i = lf.firstSeg; i < lf.firstSeg + lf.segCount; i++) {
+      if (segs[i].aligned) continue;
+      segs[i].offset = i > lf.firstSeg
+          ? (int64_t)segs[i - 1].tMax + segs[i - 1].offset + 1 - segs[i].tMin : 0;
+    }
+  }
+}
+
+/*
+  PASS 2: SONGS
+  A song occurrence is one playback of a song heard by one or more rigs. It
+  collects each rig's clips and is written out once every stream has moved
+  past its end, so only songs still playing are held in memory.
+*/
+struct MergedClip {
+  std::string dev;
+  std::string file;
+  uint32_t startMs, endMs;
+};
+
+struct SongOcc {
+  uint32_t uriHash;
+  std::string uri, title;
+  uint32_t durationMs;
+  int64_t epoch;        // aligned time of song position 0
+  int64_t lastAt;       // latest aligned time attributed to it
+  int refs;             // open song spans / clips still pointing here
+  std::vector<MergedClip> clips;
+};
+
+/**
+ * Writes the merged project as an OTIO SerializableCollection holding one
+ * Timeline.1 per song occurrence, with one video track per rig.
+ */
+class OtioCollectionWriter {
+ public:
+  explicit OtioCollectionWriter(FILE* out) : out_(out), count_(0) {}
+
+  void begin(const std::vector<std::string>& devs) {
+    fputs("{\n  \"OTIO_SCHEMA\": \"SerializableCollection.1\",\n", out_);
+    fputs("  \"name\": \"MultiRig\",\n", out_);
+    fputs("  \"metadata\": {\"musicsync\": {\"devices\": [", out_);
+    for (size_t i = 0; i < devs.size(); i++) {
+      fputs(i ? ", \"" : "\"", out_); put_json(devs[i].c_str()); fputc('"', out_);
+    }
+    fputs("]}},\n  \"children\": [", out_);
+  }
+
+  void song(SongOcc& s);
+
+  void end() {
+    fputs(count_ ? "\n  ]\n}\n" : "]\n}\n", out_);
+  }
+
+  int songs() const { return count_; }
+
+ private:
+  void put_json(const char* s) {
+    for (; *s; s++) {
+      unsigned char c = (unsigned char)*s;
+      if (c == '"' || c == '\\') fprintf(out_, "\\%c", c);
+      else if (c < 0x20) fprintf(out_, "\\u%04x", c);
+      else fputc(c, out_);
+    }
+  }
+
+  void put_range(uint64_t start, uint64_t dur) {
+    double rate = (double)MERGE_RATE.num / MERGE_RATE.den;
+    fprintf(out_, "{\"OTIO_SCHEMA\": \"TimeRange.1\", "
+                  "\"start_time\": {\"OTIO_SCHEMA\": \"RationalTime.1\", \"rate\": %.10g, \"value\": %llu}, "
+                  "\"duration\": {\"OTIO_SCHEMA\": \"RationalTime.1\", \"rate\": %.10g, \"value\": %llu}}",
+            rate, (unsigned long long)start, rate, (unsigned long long)dur);
+  }
+
+  FILE* out_;
+  int count_;
+};
+
+/**
+ * Write one song occurrence.
+ * @brief Clips are laid out by song time. A rig whose clips overlap (a reset
+ *        mid-clip, say) gets a second lane rather than losing footage.
+ */
+void OtioCollectionWriter::song(SongOcc& s) {
+  std::sort(s.clips.begin(), s.clips.end(), [](const MergedClip& a, const MergedClip& b) {
+    return a.dev != b.dev ? a.dev < b.dev : a.startMs < b.startMs;
+  });
+
+  struct Lane { std::string dev; int index; uint64_t cursor; std::vector<const MergedClip*> clips; };
+  std::vector<Lane> lanes;
+  for (const MergedClip& c : s.clips) {
+    if (c.endMs <= c.startMs) continue;
+    uint64_t start = ms_to_frames(c.startMs, MERGE_RATE);
+    Lane* lane = nullptr;
+    int index = 0;
+    for (Lane& l : lanes) {
+      if (l.dev != c.dev) continue;
+      index++;
+      if (l.cursor <= start) { lane = &l; break; }
+    }
+    if (!lane) {
+      lanes.push_back(Lane{ c.dev, index, 0, {} });
+      lane = &lanes.back();
+    }
+    lane->clips.push_back(&c);
+    lane->cursor = ms_to_frames(c.endMs, MERGE_RATE);
+  }
+
+  fputs(count_++ ? ",\n" : "\n", out_);
+  fputs("    {\"OTIO_SCHEMA\": \"Timeline.1\", \"name\": \"", out_);
+  put_json(s.title.c_str());
+  fputs("\", \"global_start_time\": null,\n", out_);
+  fputs("     \"metadata\": {\"musicsync\": {\"uri\": \"", out_);
+  put_json(s.uri.c_str());
+  fputs("\", \"title\": \"", out_);
+  put_json(s.title.c_str());
+  fprintf(out_, "\", \"durationMs\": %lu, \"alignedMs\": %lld}},\n",
+          (unsigned long)s.durationMs, (long long)s.epoch);
+  fputs("     \"tracks\": {\"OTIO_SCHEMA\": \"Stack.1\", \"name\": \"tracks\", \"metadata\": {}, "
+        "\"children\": [", out_);
+
+  for (size_t li = 0; li < lanes.size(); li++) {
+    const Lane& l = lanes[li];
+    fputs(li ? ",\n" : "\n", out_);
+    fputs("       {\"OTIO_SCHEMA\": \"Track.1\", \"name\": \"", out_);
+    put_json(l.dev.c_str());
+    if (l.index) fprintf(out_, " (%d)", l.index + 1);
+    fputs("\", \"kind\": \"Video\", \"metadata\": {\"musicsync\": {\"dev\": \"", out_);
+    put_json(l.dev.c_str());
+    fputs("\"}}, \"children\": [", out_);
+
+    uint64_t cursor = 0;
+    bool first = true;
+    for (const MergedClip* c : l.clips) {
+      uint64_t start = ms_to_frames(c->startMs, MERGE_RATE);
+      uint64_t end = ms_to_frames(c->endMs, MERGE_RATE);
+      if (start > cursor) {
+        fputs(first ? "\n" : ",\n", out_);
+        first = false;
+        fputs("         {\"OTIO_SCHEMA\": \"Gap.1\", \"name\": \"\", \"source_range\": ", out_);
+        put_range(0, start - cursor);
+        fputs("}", out_);
+        cursor = start;
+      }
+      fputs(first ? "\n" : ",\n", out_);
+      first = false;
+      fputs("         {\"OTIO_SCHEMA\": \"Clip.1\", \"name\": \"", out_);
+      put_json(c->file.c_str());
+      fputs("\", \"source_range\": ", out_);
+      put_range(0, end - start);
+      fputs(", \"media_reference\": {\"OTIO_SCHEMA\": \"ExternalReference.1\", \"target_url\": \"", out_);
+      put_json(c->file.c_str());
+      fputs("\", \"available_range\": null, \"metadata\": {}}", out_);
+      fprintf(out_, ", \"metadata\": {\"musicsync\": {\"startSongMs\": %lu, \"endSongMs\": %lu}}, "
+                    "\"effects\": [], \"markers\": []}",
+              (unsigned long)c->startMs, (unsigned long)c->endMs);
+      cursor = end;
+    }
+    fputs(l.clips.empty() ? "]}" : "\n       ]}", out_);
+  }
+  fputs(lanes.empty() ? "]}}" : "\n     ]}}", out_);
+}
+
+/*
+  PASS 2: K-WAY MERGE
+*/
+/**
+ * One log being merged: its reader, next record and per-device state.
+ */
+struct Stream {
+  LineReader rd;
+  const LogFile* lf;
+  int seg;              // segment of the current line
+  const char* line;
+  Record rec;
+  int64_t at;           // aligned time of the current line
+
+  // Song and clip state, as TimelineParser keeps it
+  int song;             // open song occurrence (index into g_songs), -1 = none
+  std::string uri, title;
+  uint32_t durationMs;
+  bool clipOpen;
+  char clipFile[64];
+  uint32_t clipStart, clipLast;
+  int clipSong;
+};
+
+static std::vector<std::unique_ptr<SongOcc>> g_songs;  // open occurrences (nullptr = written)
+static std::vector<int> g_free_songs;
+
+/**
+ * Read the next line of a stream and compute its merge key.
+ * @return false at end of file
+ */
+static bool stream_advance(Stream& s, const std::vector<Segment>& segs) {
+  s.line = s.rd.next();
+  if (!s.line) return false;
+  int last = s.lf->firstSeg + s.lf->segCount - 1;
+  while (s.seg < last && s.rd.offset() >= segs[s.seg + 1].begin) s.seg++;
+  parse_record(s.line, &s.rec);
+  // Unstamped lines keep the time of the line before them
+  if (s.rec.stamped) s.at = (int64_t)s.rec.stamp.t + segs[s.seg].offset;
+  return true;
+}
+
+static void song_release(int idx) {
+  if (idx >= 0 && g_songs[idx]) g_songs[idx]->refs--;
+}
+
+/**
+ * Find the occurrence this playback belongs to, or start one.
+ */
+static int song_attach(Stream& s, int64_t epoch, uint32_t tol) {
+  uint32_t h = fnv1a(s.uri.c_str());
+  for (size_t i = 0; i < g_songs.size(); i++) {
+    SongOcc* o = g_songs[i].get();
+    if (o && o->uriHash == h && llabs(o->epoch - epoch) <= (int64_t)tol) {
+      o->refs++;
+      return (int)i;
+    }
+  }
+  std::unique_ptr<SongOcc> o(new SongOcc());
+  o->uriHash = h;
+  o->uri = s.uri;
+  o->title = s.title;
+  o->durationMs = s.durationMs;
+  o->epoch = epoch;
+  o->lastAt = epoch;
+  o->refs = 1;
+  int idx;
+  if (!g_free_songs.empty()) {
+    idx = g_free_songs.back();
+    g_free_songs.pop_back();
+    g_songs[idx] = std::move(o);
+  } else {
+    idx = (int)g_songs.size();
+    g_songs.push_back(std::move(o));
+  }
+  return idx;
+}
+
+static void clip_close(Stream& s, const char* dev, uint32_t endMs) {
+  if (!s.clipOpen) return;
+  s.clipOpen = false;
+  if (s.clipSong >= 0 && g_songs[s.clipSong] && endMs > s.clipStart)
+    g_songs[s.clipSong]->clips.push_back(MergedClip{ dev, s.clipFile, s.clipStart, endMs });
+  song_release(s.clipSong);
+  s.clipSong = -1;
+}
+
+/**
+ * Apply a stream's current record to its song / clip state.
+ */
+static void stream_apply(Stream& s, const std::vector<Segment>& segs, uint32_t tol) {
+  const Record& r = s.rec;
+  const char* dev = segs[s.seg].dev;
+
+  if (r.type == REC_SONG) {
+    // The old clip's CLIP_END follows this line, so only the song span ends
+    song_release(s.song);
+    s.song = -1;
+    s.uri = r.uri;
+    s.title = r.title;
+    s.durationMs = r.durationMs;
+    return;
+  }
+  if (r.type == REC_OTHER) return;
+
+  if (s.song < 0 && !s.uri.empty() && r.type != REC_END && r.type != REC_LOST)
+    s.song = song_attach(s, s.at - r.songMs, tol);
+  if (s.song >= 0 && g_songs[s.song] && s.at > g_songs[s.song]->lastAt)
+    g_songs[s.song]->lastAt = s.at;
+
+  bool sameClip = s.clipOpen && strcmp(s.clipFile, r.file) == 0;
+  switch (r.type) {
+    case REC_START:
+    case REC_AT:
+      if (r.type == REC_START || !sameClip) {
+        clip_close(s, dev, s.clipLast);
+        s.clipOpen = true;
+        memcpy(s.clipFile, r.file, sizeof(s.clipFile));
+        s.clipStart = s.clipLast = r.songMs;
+        s.clipSong = s.song;
+        if (s.clipSong >= 0) g_songs[s.clipSong]->refs++;
+      }
+      if (r.songMs > s.clipLast) s.clipLast = r.songMs;
+      break;
+    case REC_GAP:
+      if (sameClip && r.songMs > s.clipLast) s.clipLast = r.songMs;
+      break;
+    case REC_END:
+      if (sameClip) clip_close(s, dev, r.songMs);
+      break;
+    case REC_LOST:  // the camera never started it: no clip
+      if (sameClip) clip_close(s, dev, 0);
+      break;
+    default:
+      break;
+  }
+}
+
+/**
+ * Write every occurrence no stream can still add to.
+ * @param frontier Smallest merge key still queued (INT64_MAX at the end)
+ */
+static void flush_songs(OtioCollectionWriter& w, int64_t frontier, size_t* clips) {
+  for (size_t i = 0; i < g_songs.size(); i++) {
+    SongOcc* o = g_songs[i].get();
+    if (!o || o->refs > 0) continue;
+    int64_t end = std::max(o->lastAt, o->epoch + (int64_t)o->durationMs) + SONG_FLUSH_MS;
+    if (frontier != INT64_MAX && frontier <= end) continue;
+    *clips += o->clips.size();
+    w.song(*o);
+    g_songs[i].reset();
+    g_free_songs.push_back((int)i);
+  }
+}
+
+/*
+  MAIN
+*/
+static void usage() {
+  fprintf(stderr,
+    "usage: msync-merge [options] rig1/events.log rig2/events.log ...\n"
+    "  -o FILE      multi-track OTIO project (default project.otio, - = stdout)\n"
+    "  -e FILE      also write the merged event stream, each line with \" at=<ms>\"\n"
+    "  --tol MS     clock alignment tolerance (default 500)\n"
+    "  -v           print every boot segment's clock offset\n");
+}
+
+int main(int argc, char** argv) {
+  const char* outPath = "project.otio";
+  const char* eventsPath = nullptr;
+  uint32_t tol = ALIGN_TOL_MS;
+  bool verbose = false;
+  std::vector<LogFile> files;
+
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    bool more = i + 1 < argc;
+    if (a == "-o" && more) outPath = argv[++i];
+    else if (a == "-e" && more) eventsPath = argv[++i];
+    else if (a == "--tol" && more) tol = (uint32_t)atoi(argv[++i]);
+    else if (a == "-v") verbose = true;
+    else if (a[0] != '-') files.push_back(LogFile{ a, 0, 0, 0 });
+    else { usage(); return 2; }
+  }
+  if (files.empty()) { usage(); return 2; }
+
+  auto t0 = std::chrono::steady_clock::now();
+
+  // Pass 1: boots and song anchors
+  std::vector<Segment> segs;
+  std::vector<LogFile> usable;
+  int skipped = 0;
+  for (LogFile& lf : files) {
+    if (!scan_file((int)usable.size(), lf, segs)) {
+      fprintf(stderr, "%s: cannot open\n", lf.path.c_str());
+      return 1;
+    }
+    if (!lf.segCount) {
+      fprintf(stderr, "%s: no dev/seq/t stamps, skipped\n", lf.path.c_str());
+      skipped++;
+      continue;
+    }
+    usable.push_back(lf);
+  }
+  align_segments(segs, usable, tol);
+
+  std::vector<std::string> devs;
+  for (const Segment& s : segs) devs.push_back(s.dev);
+  std::sort(devs.begin(), devs.end());
+  devs.erase(std::unique(devs.begin(), devs.end()), devs.end());
+
+  int aligned = 0;
+  for (size_t i = 0; i < segs.size(); i++) {
+    const Segment& s = segs[i];
+    if (s.aligned) aligned++;
+    if (!verbose) continue;
+    fprintf(stderr, "  %-8s %s  boot at t+%lu  offset %+lld ms  ", s.dev,
+            usable[s.file].path.c_str(), (unsigned long)s.tMin, (long long)s.offset);
+    if (!s.aligned) fprintf(stderr, "UNALIGNED (no shared song)\n");
+    else if (s.alignedTo < 0) fprintf(stderr, "reference\n");
+    else fprintf(stderr, "%d votes vs %s\n", s.votes, segs[s.alignedTo].dev);
+  }
+
+  // Pass 2: k-way merge on aligned time
+  FILE* out = strcmp(outPath, "-") == 0 ? stdout : fopen(outPath, "w");
+  if (!out) { fprintf(stderr, "%s: cannot write\n", outPath); return 1; }
+  FILE* ev = nullptr;
+  if (eventsPath && !(ev = fopen(eventsPath, "w"))) {
+    fprintf(stderr, "%s: cannot write\n", eventsPath);
+    return 1;
+  }
+
+  std::vector<std::unique_ptr<Stream>> streams;
+  typedef std::pair<int64_t, int> Key;  // (aligned time, stream): ties keep input order
+  std::priority_queue<Key, std::vector<Key>, std::greater<Key>> heap;
+  for (const LogFile& lf : usable) {
+    std::unique_ptr<Stream> s(new Stream());
+    if (!s->rd.open(lf.path.c_str())) { fprintf(stderr, "%s: cannot open\n", lf.path.c_str()); return 1; }
+    s->lf = &lf;
+    s->seg = lf.firstSeg;
+    s->at = segs[lf.firstSeg].tMin + segs[lf.firstSeg].offset;
+    s->song = s->clipSong = -1;
+    s->durationMs = 0;
+    s->clipOpen = false;
+    if (stream_advance(*s, segs)) heap.push(Key(s->at, (int)streams.size()));
+    streams.push_back(std::move(s));
+  }
+
+  OtioCollectionWriter writer(out);
+  writer.begin(devs);
+  uint64_t records = 0, outOfOrder = 0;
+  size_t clips = 0, peakSongs = 0;
+  int64_t lastKey = INT64_MIN;
+  while (!heap.empty()) {
+    Key k = heap.top();
+    heap.pop();
+    Stream& s = *streams[k.second];
+    if (k.first < lastKey) outOfOrder++;
+    lastKey = std::max(lastKey, k.first);
+
+    stream_apply(s, segs, tol);
+    if (ev) fprintf(ev, "%s at=%lld\n", s.line, (long long)s.at);
+    records++;
+
+    if (stream_advance(s, segs)) {
+      heap.push(Key(s.at, k.second));
+    } else {
+      clip_close(s, segs[s.seg].dev, s.clipLast);
+      song_release(s.song);
+      s.song = -1;
+    }
+    size_t open = g_songs.size() - g_free_songs.size();
+    if (open > peakSongs) peakSongs = open;
+    flush_songs(writer, heap.empty() ? INT64_MAX : heap.top().first, &clips);
+  }
+  flush_songs(writer, INT64_MAX, &clips);
+  writer.end();
+
+  uint64_t bytes = 0;
+  for (const LogFile& lf : usable) bytes += lf.bytes;
+  bool ok = !ferror(out) && (out == stdout || fclose(out) == 0);
+  if (ev) ok = !ferror(ev) && fclose(ev) == 0 && ok;
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  if (wall <= 0) wall = 1e-9;
+
+  fprintf(stderr, "logs       %zu (%d skipped), %zu devices\n", usable.size(), skipped, devs.size());
+  fprintf(stderr, "boots      %zu (%d aligned, %zu unaligned)\n", segs.size(), aligned,
+          segs.size() - aligned);
+  fprintf(stderr, "records    %llu (%llu out of order)\n", (unsigned long long)records,
+          (unsigned long long)outOfOrder);
+  fprintf(stderr, "songs      %d with %zu clips (peak %zu open)\n", writer.songs(), clips, peakSongs);
+  fprintf(stderr, "merged     %.1f MB in %.3f s (%.0f MB/s)\n", bytes / 1e6, wall,
+          bytes / 1e6 / wall);
+  if (!ok) { fprintf(stderr, "write failed\n"); return 1; }
+  return 0;
+}
@@ -0,0 +1,581 @@
+// msync-offload: pull session files from the ESP32 over USB serial using the
+// framed bulk offload mode ('o' on the serial console), with per-file CRC-32
+// checks and re-requests of files that failed. Also emulates the device side
+// (--serve) and runs the whole path over a pseudo-terminal (--selftest).
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cobs.h"
+#include "crc32.h"
+#include "offload_frame.h"
+
+static const uint32_t CONSOLE_BAUD = 115200;     // device console rate
+static const uint32_t BAUD_SWITCH_MS = 100;      // device waits this long around a switch
+static const int ANNOUNCE_TIMEOUT_MS = 5000;     // wait for "OFFLOAD <baud> <files>"
+static const int IDLE_TIMEOUT_MS = 3000;         // no bytes for this long ends a session
+
+/*
+  SERIAL PORT
+*/
+/**
+ * Map a baud rate to a termios speed constant.
+ * @return false if the rate has no constant on this system
+ */
+static bool baud_speed(uint32_t baud, speed_t* out) {
+  switch (baud) {
+    case 9600: *out = B9600; return true;
+    case 19200: *out = B19200; return true;
+    case 38400: *out = B38400; return true;
+    case 57600: *out = B57600; return true;
+    case 115200: *out = B115200; return true;
+    case 230400: *out = B230400; return true;
+#ifdef B460800
+    case 460800: *out = B460800; return true;
+#endif
+#ifdef B921600
+    case 921600: *out = B921600; return true;
+#endif
+#ifdef B1000000
+    case 1000000: *out = B1000000; return true;
+#endif
+#ifdef B1500000
+    case 1500000: *out = B1500000; return true;
+#endif
+#ifdef B2000000
+    case 2000000: *out = B2000000; return true;
+#endif
+    default: return false;
+  }
+}
+
+/**
+ * Put a tty in raw 8N1 mode at the given rate.
+ * @return false if the rate is unsupported or tcsetattr failed
+ */
+static bool set_speed(int fd, uint32_t baud) {
+  speed_t sp;
+  struct termios t;
+  if (!baud_speed(baud, &sp) || tcgetattr(fd, &t) != 0) return false;
+  cfmakeraw(&t);
+  t.c_cflag |= CLOCAL | CREAD;
+  t.c_cc[VMIN] = 0;
+  t.c_cc[VTIME] = 0;
+  cfsetispeed(&t, sp);
+  cfsetospeed(&t, sp);
+  return tcsetattr(fd, TCSANOW, &t) == 0;
+}
+
+static bool write_all(int fd, const void* data, size_t len) {
+  const uint8_t* p = (const uint8_t*)data;
+  while (len) {
+    ssize_t n = write(fd, p, len);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && errno == EAGAIN) {
+      struct pollfd pfd = { fd, POLLOUT, 0 };
+      poll(&pfd, 1, 100);
+      continue;
+    }
+    if (n <= 0) return false;
+    p += n;
+    len -= n;
+  }
+  return true;
+}
+
+/**
+ * Wait for readable data.
+ * @return >0 readable, 0 timeout, <0 error or hang-up
+ */
+static int wait_readable(int fd, int timeoutMs) {
+  struct pollfd pfd = { fd, POLLIN, 0 };
+  int r = poll(&pfd, 1, timeoutMs);
+  if (r > 0 && !(pfd.revents & POLLIN)) return -1;
+  return r;
+}
+
+/**
+ * Read one text line (without the terminator), byte by byte so no binary
+ * data that follows it is consumed.
+ * @return false on timeout, error or hang-up
+ */
+static bool read_line(int fd, std::string& line, int timeoutMs) {
+  line.clear();
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+  for (;;) {
+    int left = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now()).count();
+    if (timeoutMs >= 0 && left <= 0) return false;
+    if (wait_readable(fd, timeoutMs >= 0 ? left : -1) <= 0) return false;
+    char c;
+    ssize_t n = read(fd, &c, 1);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+    if (n <= 0) return false;
+    if (c == '\n') return true;
+    if (c != '\r') line += c;
+  }
+}
+
+static std::string base_name(const std::string& path) {
+  size_t slash = path.rfind('/');
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+/*
+  RECEIVER
+*/
+struct RxFile {
+  std::string name;  // device path, e.g. "/events.log"
+  uint32_t size = 0;
+  bool ok = false;
+};
+
+struct Receiver {
+  std::string outDir;
+  std::vector<RxFile> files;  // manifest of the first session
+  bool finished = false;
+
+  // File in progress
+  int cur = -1;
+  std::string curName;
+  FILE* out = nullptr;
+  std::string tmpPath;
+  uint32_t curSize = 0;
+  uint32_t written = 0;
+  uint32_t crc = 0;
+  bool curOk = false;
+
+  uint64_t bytes = 0;
+  uint32_t frames = 0, crcErrors = 0, oversize = 0, seqGaps = 0;
+};
+
+static RxFile* find_file(Receiver& rx, const std::string& name) {
+  for (RxFile& f : rx.files)
+    if (f.name == name) return &f;
+  return nullptr;
+}
+
+/**
+ * Finish the file in progress: keep it only if every byte arrived and the
+ * CRC matches, otherwise delete the partial copy.
+ */
+static void close_file(Receiver& rx, bool ok) {
+  if (!rx.out) return;
+  fclose(rx.out);
+  rx.out = nullptr;
+  std::string final = rx.outDir + "/" + base_name(rx.curName);
+  if (ok && rename(rx.tmpPath.c_str(), final.c_str()) == 0) {
+    if (RxFile* f = find_file(rx, rx.curName)) f->ok = true;
+  } else {
+    remove(rx.tmpPath.c_str());
+  }
+  rx.cur = -1;
+}
+
+/**
+ * Frame handler: manifest, then FILE / DATA / FILE_END per file, then DONE.
+ */
+static void on_frame(const OffloadFrame& f, void* ctx) {
+  Receiver& rx = *(Receiver*)ctx;
+
+  switch (f.type) {
+    case OFFLOAD_MANIFEST: {
+      OffloadEntry e[OFFLOAD_MAX_FILES];
+      int n = 0;
+      if (!offload_parse_manifest(f, e, OFFLOAD_MAX_FILES, &n)) break;
+      for (int i = 0; i < n; i++) {
+        if (find_file(rx, e[i].name)) continue;  // re-request of a known file
+        RxFile rf;
+        rf.name = e[i].name;
+        rf.size = e[i].size;
+        rx.files.push_back(rf);
+      }
+      break;
+    }
+
+    case OFFLOAD_FILE: {
+      uint16_t index;
+      uint32_t size;
+      char name[OFFLOAD_NAME_MAX];
+      if (!offload_parse_file(f, &index, &size, name, sizeof(name))) break;
+      close_file(rx, false);
+      rx.cur = index;
+      rx.curName = name;
+      rx.curSize = size;
+      rx.written = 0;
+      rx.crc = 0;
+      rx.curOk = true;
+      rx.tmpPath = rx.outDir + "/" + base_name(name) + ".part";
+      rx.out = fopen(rx.tmpPath.c_str(), "wb");
+      if (!rx.out) fprintf(stderr, "%s: %s\n", rx.tmpPath.c_str(), strerror(errno));
+      break;
+    }
+
+    case OFFLOAD_DATA: {
+      uint16_t index;
+      uint32_t offset;
+      const uint8_t* bytes;
+      size_t len;
+      if (!offload_parse_data(f, &index, &offset, &bytes, &len)) break;
+      if (index != rx.cur || !rx.out) break;
+      if (offset != rx.written) {  // a block was lost
+        rx.curOk = false;
+        break;
+      }
+      if (fwrite(bytes, 1, len, rx.out) != len) rx.curOk = false;
+      rx.crc = crc32_update(rx.crc, bytes, len);
+      rx.written += len;
+      rx.bytes += len;
+      break;
+    }
+
+    case OFFLOAD_FILE_END: {
+      uint16_t index;
+      uint32_t crc;
+      if (!offload_parse_file_end(f, &index, &crc) || index != rx.cur) break;
+      close_file(rx, rx.curOk && rx.written == rx.curSize && crc == rx.crc);
+      break;
+    }
+
+    case OFFLOAD_DONE:
+      close_file(rx, false);
+      rx.finished = true;
+      break;
+  }
+}
+
+/**
+ * Run one offload session on an open port.
+ * @param only One device path to request, or empty for all files
+ * @return false if the device never announced the transfer
+ */
+static bool receive_session(int fd, uint32_t baud, const std::string& only, Receiver& rx) {
+  tcflush(fd, TCIFLUSH);
+  std::string cmd = "o " + std::to_string(baud) + (only.empty() ? "" : " " + only) + "\n";
+  if (!write_all(fd, cmd.data(), cmd.size())) return false;
+
+  // Console output may precede the announcement
+  std::string line;
+  uint32_t announced = 0;
+  while (read_line(fd, line, ANNOUNCE_TIMEOUT_MS)) {
+    if (sscanf(line.c_str(), "OFFLOAD %u", &announced) == 1) break;
+  }
+  if (!announced) {
+    fprintf(stderr, "no OFFLOAD announcement from device\n");
+    return false;
+  }
+  if (!set_speed(fd, announced)) fprintf(stderr, "warning: cannot set %u baud\n", announced);
+
+  OffloadDecoder dec(on_frame, &rx);
+  rx.finished = false;
+  uint8_t buf[4096];
+  while (!rx.finished) {
+    if (wait_readable(fd, IDLE_TIMEOUT_MS) <= 0) break;
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+    if (n <= 0) break;
+    dec.feed(buf, n);
+  }
+  close_file(rx, false);
+
+  rx.frames += dec.frames;
+  rx.crcErrors += dec.crcErrors;
+  rx.oversize += dec.oversize;
+  rx.seqGaps += dec.seqGaps;
+
+  // Let the device drop back before talking at the console rate again
+  usleep(2 * BAUD_SWITCH_MS * 1000);
+  set_speed(fd, CONSOLE_BAUD);
+  return true;
+}
+
+/**
+ * Pull every session file, then re-request the ones that failed.
+ * @return 0 if every file in the manifest arrived intact
+ */
+static int receive(const char* device, uint32_t baud, const std::string& only,
+                   const std::string& outDir, int retries) {
+  int fd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (fd < 0 || !set_speed(fd, CONSOLE_BAUD)) {
+    fprintf(stderr, "%s: %s\n", device, strerror(errno));
+    if (fd >= 0) close(fd);
+    return 1;
+  }
+  mkdir(outDir.c_str(), 0755);
+
+  Receiver rx;
+  rx.outDir = outDir;
+  auto t0 = std::chrono::steady_clock::now();
+  bool announced = receive_session(fd, baud, only, rx);
+
+  for (int attempt = 0; announced && attempt < retries; attempt++) {
+    std::vector<std::string> failed;
+    for (const RxFile& f : rx.files)
+      if (!f.ok) failed.push_back(f.name);
+    if (failed.empty()) break;
+    for (const std::string& name : failed) {
+      fprintf(stderr, "retrying %s\n", name.c_str());
+      receive_session(fd, baud, name, rx);
+    }
+  }
+  close(fd);
+
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  int bad = 0;
+  for (const RxFile& f : rx.files) {
+    printf("  %-24s %9u bytes  %s\n", f.name.c_str(), f.size, f.ok ? "ok" : "FAILED");
+    if (!f.ok) bad++;
+  }
+  printf("offloaded %zu files (%d failed), %llu bytes received in %.2f s (%.1f KB/s)\n",
+         rx.files.size(), bad, (unsigned long long)rx.bytes, secs,
+         secs > 0 ? rx.bytes / 1024.0 / secs : 0.0);
+  printf("frames %u, crc errors %u, oversize %u, sequence gaps %u\n",
+         rx.frames, rx.crcErrors, rx.oversize, rx.seqGaps);
+  return announced && bad == 0 && !rx.files.empty() ? 0 : 1;
+}
+
+/*
+  DEVICE EMULATOR
+*/
+struct ServeOut {
+  int fd;
+  uint32_t corruptEvery;  // flip a byte in every Nth frame (0 = never)
+  uint32_t frames;
+};
+
+/**
+ * Frame writer for the emulator, with optional fault injection.
+ */
+static void serve_write(const uint8_t* data, size_t len, void* ctx) {
+  ServeOut& o = *(ServeOut*)ctx;
+  if (len > 2 && o.corruptEvery && ++o.frames % o.corruptEvery == 0) {
+    std::vector<uint8_t> bad(data, data + len);
+    bad[len / 2] ^= bad[len / 2] == 0x55 ? 0x5A : 0x55;
+    write_all(o.fd, bad.data(), bad.size());
+    return;
+  }
+  write_all(o.fd, data, len);
+}
+
+/**
+ * Answer 'o [baud] [path]' lines like the firmware, serving host files as
+ * "/<basename>". Faults are injected in the first session only.
+ * @param stop Polled between commands; the emulator also ends on hang-up
+ */
+static void serve(int fd, const std::vector<std::string>& paths, uint32_t corruptEvery,
+                  const std::atomic<bool>* stop) {
+  std::string line;
+  int session = 0;
+  while (!(stop && *stop)) {
+    if (!read_line(fd, line, 200)) {
+      if (wait_readable(fd, 0) < 0) return;
+      continue;
+    }
+    if (line.empty() || line[0] != 'o') continue;
+
+    char only[OFFLOAD_NAME_MAX] = "";
+    unsigned baud = OFFLOAD_DEFAULT_BAUD;
+    sscanf(line.c_str() + 1, "%u %31s", &baud, only);
+
+    std::vector<std::string> sel;
+    std::vector<OffloadEntry> entries;
+    for (const std::string& p : paths) {
+      OffloadEntry e = {};
+      snprintf(e.name, sizeof(e.name), "/%s", base_name(p).c_str());
+      if (only[0] && strcmp(only, e.name) != 0) continue;
+      struct stat st;
+      e.size = stat(p.c_str(), &st) == 0 ? (uint32_t)st.st_size : 0;
+      if ((int)entries.size() == OFFLOAD_MAX_FILES) break;
+      entries.push_back(e);
+      sel.push_back(p);
+    }
+
+    char ann[64];
+    int n = snprintf(ann, sizeof(ann), "OFFLOAD %u %zu\n", baud, entries.size());
+    write_all(fd, ann, n);
+    tcdrain(fd);
+    usleep(BAUD_SWITCH_MS * 1000);
+    set_speed(fd, baud);
+    usleep(BAUD_SWITCH_MS * 1000);
+
+    ServeOut out = { fd, session++ == 0 ? corruptEvery : 0, 0 };
+    OffloadEncoder enc(serve_write, &out);
+    enc.sync();
+    enc.manifest(entries.data(), (int)entries.size());
+    uint32_t total = 0;
+    for (size_t i = 0; i < sel.size(); i++) {
+      FILE* f = fopen(sel[i].c_str(), "rb");
+      enc.file((uint16_t)i, f ? entries[i].size : 0, entries[i].name);
+      uint8_t block[OFFLOAD_BLOCK];
+      uint32_t off = 0, crc = 0;
+      size_t got;
+      while (f && off < entries[i].size && (got = fread(block, 1, sizeof(block), f)) > 0) {
+        enc.data((uint16_t)i, off, block, got);
+        crc = crc32_update(crc, block, got);
+        off += got;
+      }
+      if (f) fclose(f);
+      enc.file_end((uint16_t)i, crc);
+      total += off;
+    }
+    enc.done((uint16_t)entries.size(), total);
+    tcdrain(fd);
+    usleep(BAUD_SWITCH_MS * 1000);
+    set_speed(fd, CONSOLE_BAUD);
+
+    n = snprintf(ann, sizeof(ann), "[OFFLOAD] %zu files, %u bytes\n", entries.size(), total);
+    write_all(fd, ann, n);
+  }
+}
+
+static int serve_device(const char* device, const std::vector<std::string>& paths,
+                        uint32_t corruptEvery) {
+  int fd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (fd < 0 || !set_speed(fd, CONSOLE_BAUD)) {
+    fprintf(stderr, "%s: %s\n", device, strerror(errno));
+    return 1;
+  }
+  serve(fd, paths, corruptEvery, nullptr);
+  close(fd);
+  return 0;
+}
+
+/*
+  SELF-TEST
+*/
+static bool same_file(const std::string& a, const std::string& b) {
+  FILE* fa = fopen(a.c_str(), "rb");
+  FILE* fb = fopen(b.c_str(), "rb");
+  bool same = fa && fb;
+  while (same) {
+    int ca = fgetc(fa), cb = fgetc(fb);
+    if (ca != cb) same = false;
+    if (ca == EOF) break;
+  }
+  if (fa) fclose(fa);
+  if (fb) fclose(fb);
+  return same;
+}
+
+/**
+ * Known-answer checks for the framing primitives.
+ */
+static bool check_primitives() {
+  bool ok = crc32_update(0, "123456789", 9) == 0xCBF43926u;
+  ok = ok && crc32_update(crc32_update(0, "1234", 4), "56789", 5) == 0xCBF43926u;
+
+  // COBS round trips: zeros, a 254-byte run (code 0xFF), a mixed buffer
+  uint8_t in[600], enc[cobs_max_encoded(sizeof(in))], dec[sizeof(enc)];
+  for (int pass = 0; pass < 3 && ok; pass++) {
+    for (size_t i = 0; i < sizeof(in); i++)
+      in[i] = pass == 0 ? 0 : pass == 1 ? (uint8_t)(1 + i % 200) : (uint8_t)(i * 7);
+    size_t n = cobs_encode(in, sizeof(in), enc), m = 0;
+    ok = memchr(enc, 0, n) == nullptr && cobs_decode(enc, n, dec, &m) &&
+         m == sizeof(in) && memcmp(in, dec, m) == 0;
+  }
+  return ok;
+}
+
+/**
+ * End-to-end run over a pty pair: the emulator on the master, the receiver
+ * on the slave, then compare every received file with its source.
+ */
+static int selftest(const std::vector<std::string>& paths, const std::string& outDir,
+                    uint32_t baud, uint32_t corruptEvery, int retries) {
+  if (!check_primitives()) {
+    fprintf(stderr, "selftest: CRC-32 / COBS known answers FAILED\n");
+    return 1;
+  }
+
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+    fprintf(stderr, "selftest: cannot open a pty: %s\n", strerror(errno));
+    return 1;
+  }
+  fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+  std::string slave = ptsname(master);
+
+  std::atomic<bool> stop(false);
+  std::thread dev([&] { serve(master, paths, corruptEvery, &stop); });
+  int rc = receive(slave.c_str(), baud, "", outDir, retries);
+  stop = true;
+  dev.join();
+  close(master);
+
+  for (const std::string& p : paths) {
+    std::string got = outDir + "/" + base_name(p);
+    if (!same_file(p, got)) {
+      fprintf(stderr, "selftest: %s differs from %s\n", got.c_str(), p.c_str());
+      rc = 1;
+    }
+  }
+  printf("selftest over %s: %s\n", slave.c_str(), rc == 0 ? "PASS" : "FAIL");
+  return rc;
+}
+
+/*
+  MAIN
+*/
+static void usage() {
+  fprintf(stderr,
+    "usage: msync-offload [options] DEVICE            pull session files from the ESP32\n"
+    "       msync-offload --serve DEVICE FILE...      emulate the device on DEVICE\n"
+    "       msync-offload --selftest FILE...          end-to-end run over a pty pair\n"
+    "  -b BAUD       transfer rate (default 921600; console stays at 115200)\n"
+    "  -o DIR        output directory (default: offload)\n"
+    "  -f PATH       request one device file, e.g. /events.log (default: all)\n"
+    "  --retry N     re-request failed files up to N times (default 2)\n"
+    "  --corrupt N   emulator: corrupt every Nth frame of the first session\n");
+}
+
+int main(int argc, char** argv) {
+  uint32_t baud = OFFLOAD_DEFAULT_BAUD, corruptEvery = 0;
+  int retries = 2;
+  std::string outDir = "offload", only;
+  bool serveMode = false, selftestMode = false;
+  std::vector<std::string> args;
+
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    bool more = i + 1 < argc;
+    if (a == "-b" && more) baud = (uint32_t)atoi(argv[++i]);
+    else if (a == "-o" && more) outDir = argv[++i];
+    else if (a == "-f" && more) only = argv[++i];
+    else if (a == "--retry" && more) retries = atoi(argv[++i]);
+    else if (a == "--corrupt" && more) corruptEvery = (uint32_t)atoi(argv[++i]);
+    else if (a == "--serve") serveMode = true;
+    else if (a == "--selftest") selftestMode = true;
+    else if (a[0] != '-') args.push_back(a);
+    else { usage(); return 2; }
+  }
+
+  speed_t sp;
+  if (!baud_speed(baud, &sp)) {
+    fprintf(stderr, "unsupported baud rate %u\n", baud);
+    return 2;
+  }
+
+  if (selftestMode) {
+    if (args.empty()) { usage(); return 2; }
+    return selftest(args, outDir, baud, corruptEvery, retries);
+  }
+  if (serveMode) {
+    if (args.size() < 2) { usage(); return 2; }
+    return serve_device(args[0].c_str(), std::vector<std::string>(args.begin() + 1, args.end()),
+                        corruptEvery);
+  }
+  if (args.size() != 1) { usage(); return 2; }
+  return receive(args[0].c_str(), baud, only, outDir, retries);
+}
@@ -0,0 +1,542 @@
+// msync-syncsim: replay a captured /trace.log through the firmware's sync
+// engine with virtual time and a fake camera, and emit the resulting
+// events.log and shutter timeline for diffing.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ble_inbox.h"
+#include "event_format.h"
+#include "songtime_trace.h"
+#include "sync_engine.h"
+#include "text_util.h"
+#include "timeline.h"
+
+/*
+  TRACE
+*/
+struct TraceMsg {
+  uint32_t ms;
+  char source;  // 'B' or 'S'
+  std::string payload;
+};
+
+/**
+ * Load a trace file ("<ms> <B|S> <payload>" per line).
+ * @return false if the file can't be opened
+ */
+static bool load_trace(const char* path, std::vector<TraceMsg>& out) {
+  FILE* f = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+  if (!f) return false;
+
+  char line[512];
+  while (fgets(line, sizeof(line), f)) {
+    size_t n = strlen(line);
+    while (n && (line[n - 1] == '\n' || line[n - 1] == '\r')) line[--n] = '\0';
+
+    char* end = nullptr;
+    unsigned long ms = strtoul(line, &end, 10);
+    if (end == line || end[0] != ' ' || !end[1] || end[2] != ' ') continue;
+    out.push_back(TraceMsg{ (uint32_t)ms, end[1], std::string(end + 3) });
+  }
+  if (f != stdin) fclose(f);
+  return true;
+}
+
+/*
+  VIRTUAL PLATFORM
+*/
+struct CameraCmd {
+  bool on;
+  uint32_t at;  // when goproShutter() queued it
+};
+
+struct Camera {
+  uint32_t latencyMs = 350;    // HTTP round trip on the Wi-Fi task
+  uint32_t failPermille = 0;   // injected request failures
+  uint32_t rng = 1;
+  bool recording = false;
+  uint32_t starts = 0, stops = 0, fails = 0;
+  uint32_t startWhileRecording = 0, stopWhileIdle = 0;
+  std::vector<CameraCmd> queue;  // goproShutter() FIFO
+  uint32_t freeAt = 0;           // when the Wi-Fi task can send the next one
+  uint32_t downPeriodMs = 0;     // link down for downMs at the end of every period
+  uint32_t downMs = 0;
+};
+
+static uint32_t g_now = 0;        // virtual millis()
+static Camera g_cam;
+static std::string g_events;
+static std::string g_shutter;
+static bool g_verbose = false;
+
+static std::string g_dev = "sim";  // event_log_set_device()
+static uint32_t g_seq = 0;          // last stamped sequence number
+static int64_t g_boot_at = 0;       // virtual time of the last boot
+
+static BleInbox g_inbox;                    // main.cpp's BLE INBOX
+static std::vector<std::string> g_serial;  // lines for the next serial_poll()
+static uint32_t g_inbox_dropped = 0;       // inbox full, earlier boots
+
+static SongTimeStore g_songtime;     // songtime_log.cpp
+static std::string g_songtime_bin;   // /songtime.bin
+static uint32_t g_songtime_updates = 0;
+static uint32_t g_songtime_skipped = 0;  // idle blocks never written, all boots
+
+static uint32_t sim_local_ms() {
+  return (uint32_t)((int64_t)g_now - g_boot_at);
+}
+
+/**
+ * songtime_tick(): keep the open block while recording, append finished ones.
+ */
+static void songtime_drain(bool recording) {
+  if (recording) g_songtime.mark_keep();
+  uint8_t buf[2 * SONGTIME_BLOCK_MAX + SONGTIME_HEADER_BYTES];
+  size_t n = g_songtime.take(buf, sizeof(buf));
+  g_songtime_bin.append((const char*)buf, n);
+}
+
+static uint32_t sim_now_ms() {
+  return g_now;
+}
+
+static void append_event(const char* line) {
+  char stamp[EVENT_STAMP_MAX];
+  format_event_stamp(stamp, sizeof(stamp), g_dev.c_str(), ++g_seq, sim_local_ms());
+  g_events += line;
+  g_events += stamp;
+  g_events += "\r\n";  // Print::println on the device
+}
+
+static void sim_log_song(const char* uri, const char* title, uint32_t durationMs) {
+  char line[EVENT_LINE_MAX];
+  format_song_line(line, sizeof(line), uri, title, durationMs);
+  append_event(line);
+}
+
+static void sim_log_clip_start(const char* file, uint32_t songMs) {
+  char line[128];
+  format_clip_start_line(line, sizeof(line), file, songMs);
+  append_event(line);
+}
+
+static void sim_log_clip_end(const char* file, uint32_t songMs) {
+  char line[128];
+  format_clip_end_line(line, sizeof(line), file, songMs);
+  append_event(line);
+}
+
+static void sim_log_clip_gap(const char* file, uint32_t fromMs, uint32_t toMs, uint32_t pauseMs) {
+  char line[160];
+  format_clip_gap_line(line, sizeof(line), file, fromMs, toMs, pauseMs);
+  append_event(line);
+}
+
+static void sim_log_clip_at(const char* file, uint32_t songMs) {
+  char line[128];
+  format_clip_at_line(line, sizeof(line), file, songMs);
+  append_event(line);
+}
+
+static void sim_log_clip_recovered(const char* file, uint32_t songMs) {
+  char line[144];
+  format_clip_recovered_line(line, sizeof(line), file, songMs);
+  append_event(line);
+}
+
+static void sim_log_clip_lost(const char* file, uint32_t songMs) {
+  char line[128];
+  format_clip_lost_line(line, sizeof(line), file, songMs);
+  append_event(line);
+}
+
+/**
+ * Fake goproShutter(): queue the command like the firmware does.
+ */
+static bool sim_shutter(bool on) {
+  g_cam.queue.push_back(CameraCmd{ on, g_now });
+  return true;
+}
+
+/**
+ * Is the simulated Wi-Fi link down at time t (--link-down)?
+ * @return Time the link comes back, or 0 if it is up
+ */
+static uint32_t link_down_until(uint32_t t) {
+  if (!g_cam.downPeriodMs || !g_cam.downMs) return 0;
+  uint32_t phase = t % g_cam.downPeriodMs;
+  if (phase < g_cam.downPeriodMs - g_cam.downMs) return 0;
+  return t - phase + g_cam.downPeriodMs;
+}
+
+/**
+ * Fake Wi-Fi task: send queued commands in order, one per latencyMs, and
+ * record them in the shutter timeline, flagging redundant starts/stops.
+ * @param until Virtual time to run the camera up to
+ */
+static void run_camera(uint32_t until) {
+  while (!g_cam.queue.empty()) {
+    CameraCmd cmd = g_cam.queue.front();
+    uint32_t at = cmd.at > g_cam.freeAt ? cmd.at : g_cam.freeAt;
+    uint32_t up = link_down_until(at);
+    if (up) at = up;
+    if (at > until) return;
+    g_cam.queue.erase(g_cam.queue.begin());
+
+    g_cam.rng = g_cam.rng * 1103515245u + 12345u;
+    bool ok = ((g_cam.rng >> 16) % 1000) >= g_cam.failPermille;
+
+    const char* note = "";
+    if (ok) {
+      if (cmd.on && g_cam.recording) { g_cam.startWhileRecording++; note = " (already recording)"; }
+      if (!cmd.on && !g_cam.recording) { g_cam.stopWhileIdle++; note = " (already stopped)"; }
+      g_cam.recording = cmd.on;
+    } else {
+      g_cam.fails++;
+    }
+    if (cmd.on) g_cam.starts++; else g_cam.stops++;
+
+    char line[96];
+    snprintf(line, sizeof(line), "%lu %s %s%s\n", (unsigned long)at,
+             cmd.on ? "START" : "STOP", ok ? "ok" : "FAIL", note);
+    g_shutter += line;
+    g_cam.freeAt = at + g_cam.latencyMs;
+  }
+}
+
+/**
+ * Fake hook_camera_state(): down during --link-down windows, otherwise ready
+ * once the Wi-Fi task has nothing queued or in flight.
+ */
+static int sim_camera_state() {
+  if (link_down_until(g_now)) return SYNC_CAMERA_DOWN;
+  return g_cam.queue.empty() && g_now >= g_cam.freeAt ? SYNC_CAMERA_READY : SYNC_CAMERA_BUSY;
+}
+
+static void sim_print(const char* line) {
+  if (g_verbose) fprintf(stderr, "%8lu  %s\n", (unsigned long)g_now, line);
+}
+
+/*
+  RESET
+*/
+static const size_t RESET_TAIL_BYTES = 8192;    // EVENTS_TAIL_BYTES on the device
+static const uint32_t RESET_DOWN_MS = 3000;     // reboot + BLE reconnect, messages lost
+
+/**
+ * Simulate a device reset: the engine and the Wi-Fi task's queue are lost,
+ * the camera and events.log survive. Boot recovery runs on the log tail.
+ * @return Virtual time the camera status answer arrives, or 0 if none is needed
+ */
+static uint32_t sim_reset(std::unique_ptr<SyncEngine>& eng, const SyncHooks& hooks,
+                          uint32_t holdMs) {
+  g_cam.queue.clear();
+  g_inbox_dropped += g_inbox.dropped();
+  g_inbox = BleInbox();
+  g_serial.clear();
+  eng.reset(new SyncEngine());
+  eng->begin(hooks);
+  eng->set_pause_hold(holdMs);
+
+  size_t want = g_events.size() < RESET_TAIL_BYTES ? g_events.size() : RESET_TAIL_BYTES;
+  LogTail tail;
+  log_tail_scan(g_events.data() + g_events.size() - want, want, want == g_events.size(), &tail);
+  g_boot_at = g_now;
+  g_seq = tail.stamped ? tail.lastSeq : 0;
+  g_songtime_skipped += g_songtime.blocks_skipped();
+  g_songtime = SongTimeStore();  // RAM blocks are lost with the reset
+  g_songtime.begin(g_seq);
+  songtime_drain(false);
+  if (!eng->recover(tail)) return 0;
+  return g_now + g_cam.latencyMs;
+}
+
+/**
+ * Receive one inbound message the way the firmware does: a BLE write is
+ * classified and queued in the BLE inbox (handle_ble_write), a serial line
+ * waits for the next loop pass (serial_poll).
+ */
+static void deliver(const TraceMsg& m) {
+  g_now = m.ms;
+  if (m.source != 'B') {
+    g_serial.push_back(m.payload);
+    return;
+  }
+  BleInboxMsg msg;
+  if (!BleInbox::parse((const uint8_t*)m.payload.data(), m.payload.size(), sim_now_ms(), &msg)) return;
+  if (msg.time) {
+    g_songtime.add(sim_local_ms(), msg.songMs);
+    g_songtime_updates++;
+  }
+  g_inbox.push(msg);
+}
+
+/**
+ * Run what arrived since the last loop pass, in loop()'s order: serial
+ * lines, then the BLE inbox. Only the sync engine's commands are simulated.
+ */
+static void poll_inputs(SyncEngine& eng) {
+  for (std::string& line : g_serial) {
+    char buf[256];
+    safe_copy(buf, sizeof(buf), line.c_str());
+    trim_inplace(buf);
+    if (*buf) eng.handle_command(buf);
+  }
+  g_serial.clear();
+
+  static BleInboxMsg m;
+  while (g_inbox.pop(&m)) ble_inbox_route(eng, m);
+}
+
+/*
+  STRESS TRACE GENERATOR
+*/
+static uint32_t g_gen_rng = 1;
+static uint32_t gen_rand(uint32_t n) {
+  g_gen_rng = g_gen_rng * 1103515245u + 12345u;
+  return (g_gen_rng >> 16) % n;
+}
+
+/**
+ * Write a synthetic trace: songs with a 150 ms time stream, plus random
+ * pause/resume taps, metadata re-sends, seeks, mid-song track changes and
+ * quick skips to the next track and back (sometimes re-sent while held).
+ */
+static void generate_stress(FILE* out, uint32_t seconds) {
+  uint32_t t = 1000, end = seconds * 1000, song = 0;
+  while (t < end) {
+    uint32_t dur = 30000 + gen_rand(180000);
+    song++;
+    fprintf(out, "%lu B muri=apple:track:%lu;title=Song %lu;dur=%lu\n",
+            (unsigned long)t, (unsigned long)song, (unsigned long)song, (unsigned long)dur);
+    t += 20;
+    fprintf(out, "%lu B p1\n", (unsigned long)t);
+
+    uint32_t pos = 0;
+    bool playing = true;
+    while (pos < dur && t < end) {
+      t += 150;
+      if (playing) pos += 150;
+      fprintf(out, "%lu B %lu\n", (unsigned long)t, (unsigned long)pos);
+
+      uint32_t r = gen_rand(1000);
+      if (r < 6) {                       // pause / resume tap
+        playing = !playing;
+        fprintf(out, "%lu B p%d\n", (unsigned long)t, playing ? 1 : 0);
+      } else if (r < 9) {                // metadata re-sent after reconnect
+        fprintf(out, "%lu B muri=apple:track:%lu;title=Song %lu;dur=%lu\n",
+                (unsigned long)t, (unsigned long)song, (unsigned long)song, (unsigned long)dur);
+      } else if (r < 11) {               // seek
+        pos = gen_rand(dur);
+      } else if (r < 12) {               // skip to next track
+        break;
+      } else if (r < 13 && playing) {    // skip to next track and straight back
+        uint32_t next = song + 1, nextDur = 30000 + gen_rand(180000);
+        fprintf(out, "%lu B muri=apple:track:%lu;title=Song %lu;dur=%lu\n",
+                (unsigned long)t, (unsigned long)next, (unsigned long)next, (unsigned long)nextDur);
+        uint32_t steps = 1 + gen_rand(8);
+        for (uint32_t i = 1; i <= steps; i++) {
+          t += 150;
+          fprintf(out, "%lu B %lu\n", (unsigned long)t, (unsigned long)(i * 150));
+        }
+        t += 150;
+        fprintf(out, "%lu B muri=apple:track:%lu;title=Song %lu;dur=%lu\n",
+                (unsigned long)t, (unsigned long)song, (unsigned long)song, (unsigned long)dur);
+        pos = 0;
+        if (gen_rand(2)) {               // ...and re-sent while it is held
+          for (int i = 0; i < 2; i++) {
+            t += 150;
+            pos += 150;
+            fprintf(out, "%lu B %lu\n", (unsigned long)t, (unsigned long)pos);
+          }
+          fprintf(out, "%lu B muri=apple:track:%lu;title=Song %lu;dur=%lu\n",
+                  (unsigned long)t, (unsigned long)song, (unsigned long)song, (unsigned long)dur);
+        }
+      }
+    }
+    t += 100 + gen_rand(2000);
+  }
+}
+
+/*
+  MAIN
+*/
+static void usage() {
+  fprintf(stderr,
+    "usage: msync-syncsim [options] trace.log|-\n"
+    "       msync-syncsim --gen-stress SECONDS [--seed N] > trace.log\n"
+    "  -e FILE        write resulting events.log (default: stdout)\n"
+    "  -s FILE        write shutter timeline (default: none)\n"
+    "  -t FILE        write the song-time trace (/songtime.bin) (default: none)\n"
+    "  --tick MS      main-loop period in virtual ms (default 1)\n"
+    "  --latency MS   fake camera HTTP latency per command (default 350)\n"
+    "  --reset MS     reset the device at virtual time MS (boot recovery)\n"
+    "  --hold MS      pause hold before a pause ends the clip (default 1500)\n"
+    "  --fail N       fail N per mille of shutter requests (default 0)\n"
+    "  --link-down P:L  Wi-Fi link down for the last L ms of every P ms (default never)\n"
+    "  --seed N       PRNG seed for --fail / --gen-stress (default 1)\n"
+    "  --dev ID       device ID stamped on events (default sim)\n"
+    "  --uptime MS    device uptime at trace time 0, for the t= stamps (default 0)\n"
+    "  -v             print engine diagnostics with virtual timestamps\n");
+}
+
+static bool write_file(const char* path, const std::string& data) {
+  FILE* f = strcmp(path, "-") == 0 ? stdout : fopen(path, "wb");
+  if (!f) return false;
+  fwrite(data.data(), 1, data.size(), f);
+  if (f != stdout) fclose(f);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  const char* tracePath = nullptr;
+  const char* eventsPath = "-";
+  const char* shutterPath = nullptr;
+  const char* songtimePath = nullptr;
+  uint32_t tickMs = 1, genSeconds = 0, holdMs = SYNC_PAUSE_HOLD_MS, resetMs = 0;
+
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    bool more = i + 1 < argc;
+    if (a == "-e" && more) eventsPath = argv[++i];
+    else if (a == "-s" && more) shutterPath = argv[++i];
+    else if (a == "-t" && more) songtimePath = argv[++i];
+    else if (a == "--tick" && more) tickMs = (uint32_t)atoi(argv[++i]);
+    else if (a == "--latency" && more) g_cam.latencyMs = (uint32_t)atoi(argv[++i]);
+    else if (a == "--reset" && more) resetMs = (uint32_t)atoi(argv[++i]);
+    else if (a == "--hold" && more) holdMs = (uint32_t)atoi(argv[++i]);
+    else if (a == "--fail" && more) g_cam.failPermille = (uint32_t)atoi(argv[++i]);
+    else if (a == "--link-down" && more) {
+      const char* v = argv[++i];
+      const char* colon = strchr(v, ':');
+      g_cam.downPeriodMs = (uint32_t)atoi(v);
+      g_cam.downMs = colon ? (uint32_t)atoi(colon + 1) : 0;
+      if (g_cam.downMs > g_cam.downPeriodMs) g_cam.downMs = g_cam.downPeriodMs;
+    }
+    else if (a == "--seed" && more) g_cam.rng = g_gen_rng = (uint32_t)atoi(argv[++i]);
+    else if (a == "--gen-stress" && more) genSeconds = (uint32_t)atoi(argv[++i]);
+    else if (a == "--dev" && more) g_dev = argv[++i];
+    else if (a == "--uptime" && more) g_boot_at = -(int64_t)atoll(argv[++i]);
+    else if (a == "-v") g_verbose = true;
+    else if (a == "-" || a[0] != '-') tracePath = argv[i];
+    else { usage(); return 2; }
+  }
+  if (tickMs == 0) tickMs = 1;
+
+  if (genSeconds) {
+    generate_stress(stdout, genSeconds);
+    return 0;
+  }
+  if (!tracePath) { usage(); return 2; }
+
+  std::vector<TraceMsg> trace;
+  if (!load_trace(tracePath, trace)) {
+    fprintf(stderr, "%s: cannot open\n", tracePath);
+    return 1;
+  }
+
+  SyncHooks hooks = {
+    sim_now_ms, sim_log_song, sim_log_clip_start, sim_log_clip_end, sim_log_clip_gap,
+    sim_log_clip_at, sim_log_clip_recovered, sim_log_clip_lost, sim_shutter, sim_print,
+    sim_camera_state,
+  };
+  std::unique_ptr<SyncEngine> eng(new SyncEngine());
+  eng->begin(hooks);
+  eng->set_pause_hold(holdMs);
+  g_songtime.begin(g_seq);
+  bool resetDone = resetMs == 0;
+  uint32_t statusAt = 0;  // camera status answer for boot recovery
+
+  auto t0 = std::chrono::steady_clock::now();
+  uint64_t loops = 0;
+
+  // Messages are delivered at their capture time, ahead of the next loop
+  // pass (the firmware's BLE inbox drains at the top of loop()); the main
+  // loop runs every tickMs; the camera drains its queue on its own timeline.
+  size_t next = 0;
+  uint32_t endMs = trace.empty() ? 0 : trace.back().ms + 5000;
+  uint32_t loopTime = trace.empty() ? 0 : trace.front().ms;
+  while (next < trace.size() || loopTime <= endMs) {
+    if (next < trace.size() && trace[next].ms < loopTime) {
+      run_camera(trace[next].ms);
+      if (resetMs && resetDone && trace[next].ms >= resetMs && trace[next].ms < resetMs + RESET_DOWN_MS) {
+        next++;  // device rebooting
+        continue;
+      }
+      deliver(trace[next++]);
+      continue;
+    }
+    g_now = loopTime;
+    run_camera(loopTime);
+    if (!resetDone && loopTime >= resetMs) {
+      resetDone = true;
+      statusAt = sim_reset(eng, hooks, holdMs);
+    }
+    poll_inputs(*eng);
+    if (statusAt && loopTime >= statusAt) {
+      statusAt = 0;
+      eng->finish_recovery(g_cam.recording);
+    }
+    eng->tick();
+    eng->service_camera();
+    songtime_drain(eng->recording());
+    loopTime += tickMs;
+    loops++;
+  }
+  run_camera(UINT32_MAX);
+  g_songtime.flush();  // export_project()
+  songtime_drain(false);
+
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  if (wall <= 0) wall = 1e-9;
+  double simSecs = trace.empty() ? 0 : (endMs - trace.front().ms) / 1000.0;
+
+  if (!write_file(eventsPath, g_events)) {
+    fprintf(stderr, "%s: cannot write\n", eventsPath);
+    return 1;
+  }
+  if (shutterPath && !write_file(shutterPath, g_shutter)) {
+    fprintf(stderr, "%s: cannot write\n", shutterPath);
+    return 1;
+  }
+  if (songtimePath && !write_file(songtimePath, g_songtime_bin)) {
+    fprintf(stderr, "%s: cannot write\n", songtimePath);
+    return 1;
+  }
+
+  fprintf(stderr, "messages   %zu, %u BLE writes dropped (inbox full)\n", trace.size(),
+          g_inbox_dropped + g_inbox.dropped());
+  fprintf(stderr, "loops      %llu\n", (unsigned long long)loops);
+  fprintf(stderr, "shutter    %u start, %u stop, %u failed\n", g_cam.starts, g_cam.stops, g_cam.fails);
+  fprintf(stderr, "anomalies  %u start-while-recording, %u stop-while-idle\n",
+          g_cam.startWhileRecording, g_cam.stopWhileIdle);
+  const SyncStats& st = eng->stats();
+  fprintf(stderr, "metadata   %u applied, %u duplicate, %u stale, %u deferred\n",
+          st.metaApplied, st.metaDuplicate, st.metaStale, st.metaDeferred);
+  fprintf(stderr, "pauses     %u bridged (hold %u ms), %u shutter pairs cancelled, %u expired\n",
+          st.pausesBridged, holdMs, st.shutterPairsCancelled, st.shutterExpired);
+  if (resetMs)
+    fprintf(stderr, "reset      at %u ms: %u clip recovered, %u resumed\n",
+            resetMs, st.clipsRecovered, st.clipsResumed);
+  if (songtimePath) {
+    uint32_t kept = 0;
+    SongTimeBlock b;
+    const uint8_t* bin = (const uint8_t*)g_songtime_bin.data();
+    for (size_t off = 0; songtime_parse_header(bin + off, g_songtime_bin.size() - off, &b);
+         off += SONGTIME_HEADER_BYTES + b.payloadBytes)
+      kept += b.count;
+    fprintf(stderr, "songtime   %u updates, %u kept in %zu B (%.2f B/update), %u blocks skipped\n",
+            g_songtime_updates, kept, g_songtime_bin.size(),
+            kept ? (double)g_songtime_bin.size() / kept : 0.0,
+            g_songtime_skipped + g_songtime.blocks_skipped());
+  }
+  fprintf(stderr, "simulated  %.1f s in %.3f s wall (%.0fx real-time, %.0f msgs/s)\n",
+          simSecs, wall, simSecs / wall, trace.size() / wall);
+  return 0;
+}